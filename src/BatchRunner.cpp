@@ -0,0 +1,106 @@
+#include "BatchRunner.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include "WorkStealingPool.h"
+
+namespace
+{
+    bool isRomFile(const std::filesystem::path& path)
+    {
+        std::string extension = path.extension().string();
+        return extension == ".ch8" || extension == ".sc8" || extension == ".xo8";
+    }
+}
+
+std::vector<std::string> BatchRunner::collectRoms(const std::vector<std::string> &paths)
+{
+    std::vector<std::string> roms;
+    for (const std::string &path : paths)
+    {
+        if (!path.empty() && path[0] == '@')
+        {
+            std::ifstream list(path.substr(1));
+            std::string line;
+            while (std::getline(list, line))
+            {
+                if (!line.empty())
+                    roms.push_back(line);
+            }
+        }
+        else if (std::filesystem::is_directory(path))
+        {
+            std::vector<std::string> found;
+            for (const auto &entry : std::filesystem::directory_iterator(path))
+            {
+                if (entry.is_regular_file() && isRomFile(entry.path()))
+                    found.push_back(entry.path().string());
+            }
+            std::sort(found.begin(), found.end()); // Stable order so result files diff cleanly
+            roms.insert(roms.end(), found.begin(), found.end());
+        }
+        else
+        {
+            roms.push_back(path);
+        }
+    }
+    return roms;
+}
+
+batchResult BatchRunner::runOne(const std::string &romPath, const batchOptions &options)
+{
+    Chip8 c8machine{ std::vector<uint8_t>() };
+    return runOne(c8machine, romPath, options);
+}
+
+batchResult BatchRunner::runOne(Chip8 &c8machine, const std::string &romPath, const batchOptions &options)
+{
+    batchResult result;
+    result.romPath = romPath;
+    auto start = std::chrono::steady_clock::now();
+    try
+    {
+        c8machine.quirks = options.romQuirks ? configuration::quirksForRom(romPath) : options.quirks;
+        c8machine.interpreter = options.interpreter;
+        c8machine.reset(romPath);
+        for (uint64_t frame = 0; frame < options.frames && c8machine.state != Chip8::STOPPED; ++frame)
+        {
+            result.instructions += c8machine.run(options.instructionsPerFrame);
+            c8machine.updateTimers();
+        }
+        result.displayHash = c8machine.displayHash();
+        c8machine.takeTrap(result.trap);
+        result.ok = true;
+    }
+    catch (const std::exception &e)
+    {
+        result.error = e.what();
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+std::vector<batchResult> BatchRunner::run(const std::vector<std::string> &roms, const batchOptions &options)
+{
+    std::vector<batchResult> results(roms.size());
+    // One machine per worker, reset for each ROM instead of constructed, keeps the decode cache allocation warm
+    std::vector<std::unique_ptr<Chip8>> machines(options.threads ? options.threads : WorkStealingPool::defaultThreads());
+    std::vector<WorkStealingPool::task> tasks;
+    tasks.reserve(roms.size());
+    for (size_t i = 0; i < roms.size(); ++i)
+    {
+        tasks.push_back([&, i](unsigned worker)
+        {
+            if (!machines[worker])
+            {
+                machines[worker] = std::make_unique<Chip8>(std::vector<uint8_t>());
+            }
+            results[i] = runOne(*machines[worker], roms[i], options);
+        });
+    }
+    WorkStealingPool::run(tasks, options.threads);
+    return results;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Chip8.h"
+#include "Configuration.h"
+
+struct batchOptions
+{
+    uint64_t frames = 600; // Emulated frames per ROM
+    int instructionsPerFrame = configuration::INSTRUCTIONS_PER_FRAME;
+    Quirks quirks;
+    bool romQuirks = false; // Take each ROM's quirks from the configuration instead of quirks
+    Chip8::interpreterMode interpreter = Chip8::CACHED;
+    unsigned threads = 0; // 0 picks one per hardware thread
+};
+
+struct batchResult
+{
+    std::string romPath;
+    bool ok = false;
+    std::string error; // Set when the ROM could not be loaded
+    uint64_t displayHash = 0; // Final framebuffer
+    uint64_t instructions = 0;
+    double seconds = 0;
+    trapRecord trap; // First fault the ROM hit and how many there were, count 0 when none
+};
+
+// Runs every ROM headless on a work-stealing pool, each worker resetting one Chip8 instance per ROM
+class BatchRunner
+{
+    public:
+        // Directories expand to the .ch8/.sc8/.xo8 files inside them, "@file" reads one path per line
+        static std::vector<std::string> collectRoms(const std::vector<std::string>& paths);
+        static std::vector<batchResult> run(const std::vector<std::string>& roms, const batchOptions& options);
+        static batchResult runOne(const std::string& romPath, const batchOptions& options);
+        static batchResult runOne(Chip8& c8machine, const std::string& romPath, const batchOptions& options); // Resets c8machine onto the ROM first
+};
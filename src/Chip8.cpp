@@ -1,109 +1,235 @@
 #include "Chip8.h"
-#include <iostream>
-#include "SDL_MainComponents.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
 #include "Configuration.h"
-#include <random>
-#include <thread>
-#include <atomic>
-#include <mutex>
 
 //A nibble is 4 bits
 
+namespace
+{
+    constexpr uint32_t IDLE_MAX_PERIOD = 256; // Longest idle loop probeIdle looks for, in instructions
+    constexpr size_t IDLE_STATE_OFFSET = offsetof(Chip8State, stack); // Past display and memory, probeIdle compares and rollBack copies from here on
+}
+
 void Chip8::updateTimers()
 {
     if (delayTimer > 0)
     {
         --delayTimer;
     }
-    if (soundTimer > 0)
+    if (audio)
     {
-        SDL_ResumeAudioStreamDevice(beeper.stream); // Unpause audio device if sound timer is active
-        --soundTimer;
+        if (soundChanged)
+        {
+            audio->setPattern(patternLoaded ? audioPattern : nullptr, pitch);
+            soundChanged = false;
+        }
+        audio->setSoundTimer(soundTimer); // Beep while the sound timer is active
     }
-    else
+    if (soundTimer > 0)
     {
-        SDL_PauseAudioStreamDevice(beeper.stream); // Pause audio device if sound timer is not active
+        --soundTimer;
     }
 }
 
 void Chip8::handleInput()
 {
-    SDL_Event event;
-    while (SDL_PollEvent(&event))
+    if (input)
     {
-        switch (event.type)
-        {
-            case SDL_EVENT_QUIT:
-                state = Chip8::STOPPED;
-                break;
-            case SDL_EVENT_KEY_DOWN:
-                switch (event.key.key)
-                {
-                    case SDLK_ESCAPE:
-                        state = Chip8::STOPPED;
-                        break;
-                    case SDLK_SPACE:
-                        if (state == Chip8::RUNNING) 
-                        {
-                            state = Chip8::PAUSED;
-                        }
-                        else if (state == Chip8::PAUSED)
-                        {
-                            state = Chip8::RUNNING;
-                        }
-                        break;
-                    case SDLK_1: keypad[0x1] = true; std::cout << "Key 1 pressed" << std::endl; break;
-                    case SDLK_2: keypad[0x2] = true; break;
-                    case SDLK_3: keypad[0x3] = true; break;
-                    case SDLK_4: keypad[0xC] = true; break;
-                    case SDLK_Q: keypad[0x4] = true; break;
-                    case SDLK_W: keypad[0x5] = true; break;
-                    case SDLK_E: keypad[0x6] = true; break;
-                    case SDLK_R: keypad[0xD] = true; break;
-                    case SDLK_A: keypad[0x7] = true; break;
-                    case SDLK_S: keypad[0x8] = true; break;
-                    case SDLK_D: keypad[0x9] = true; break;
-                    case SDLK_F: keypad[0xE] = true; break;
-                    case SDLK_Z: keypad[0xA] = true; break;
-                    case SDLK_X: keypad[0x0] = true; break;
-                    case SDLK_C: keypad[0xB] = true; break;
-                    case SDLK_V: keypad[0xF] = true; break;
-                }
-                break;
-            case SDL_EVENT_KEY_UP:
-                switch (event.key.key)
-                {
-                    case SDLK_1: keypad[0x1] = false; break;
-                    case SDLK_2: keypad[0x2] = false; break;
-                    case SDLK_3: keypad[0x3] = false; break;
-                    case SDLK_4: keypad[0xC] = false; break;
-                    case SDLK_Q: keypad[0x4] = false; break;
-                    case SDLK_W: keypad[0x5] = false; break;
-                    case SDLK_E: keypad[0x6] = false; break;
-                    case SDLK_R: keypad[0xD] = false; break;
-                    case SDLK_A: keypad[0x7] = false; break;
-                    case SDLK_S: keypad[0x8] = false; break;
-                    case SDLK_D: keypad[0x9] = false; break;
-                    case SDLK_F: keypad[0xE] = false; break;
-                    case SDLK_Z: keypad[0xA] = false; break;
-                    case SDLK_X: keypad[0x0] = false; break;
-                    case SDLK_C: keypad[0xB] = false; break;
-                    case SDLK_V: keypad[0xF] = false; break;
-                }
-                break;
-        }
+        input->pollInput(*this);
     }
 }
 
 void Chip8::emulateInstruction()
 {
-    currentInstruction = instruction_t(memory[pc] << 8 | memory[pc + 1]);
+    decoded_t &entry = decodeCache[pc & addressMask];
+    if (!entry.handler)
+    {
+        entry.instruction = instruction_t(memory[pc & addressMask] << 8 | memory[(pc + 1) & addressMask]);
+        entry.handler = decoder(entry.instruction.opcode);
+    }
+    currentInstruction = entry.instruction;
+#if SDL_C8_PROFILER
+    if (profiler) profiler->countInstruction(pc, currentInstruction.opcode);
+#endif
+    pc += 2;
+    entry.handler(*this);
+}
+
+void Chip8::emulateInstructionUncached()
+{
+    currentInstruction = instruction_t(memory[pc & addressMask] << 8 | memory[(pc + 1) & addressMask]);
+#if SDL_C8_PROFILER
+    if (profiler) profiler->countInstruction(pc, currentInstruction.opcode);
+#endif
     pc += 2;
     uint8_t nibble = (currentInstruction.opcode >> 12) & 0xF;
     opcodeTable[nibble](*this); // Call the appropriate opcode handler
 
 }
+
+void Chip8::invalidateDecodeCache(uint16_t address, uint16_t length)
+{
+    // An entry covers the bytes at pc and pc + 1 (up to pc + 3 when fused), so the ones starting just before the write go too
+    for (int i = -3; i < length; ++i)
+    {
+        decoded_t &entry = decodeCache[(address + i) & addressMask];
+        entry.handler = nullptr;
+        entry.target = nullptr;
+    }
+    ++memoryWrites;
+    if (recordWrites)
+    {
+        if (rollBackWrites.size() < ROLLBACK_MAX_WRITES)
+            rollBackWrites.push_back({ address, length });
+        else
+            rollBackOverflow = true;
+    }
+    if (jit)
+    {
+        jit->invalidate(address, length);
+    }
+}
+
+void Chip8::applyQuirks()
+{
+    // Pick the interpreters specialised for these quirks, everything decoded or compiled so far used the old ones
+    activeQuirks = quirks.bits();
+    decoder = Opcodes::decoderFor(activeQuirks);
+    threadedRunner = threadedFor(activeQuirks);
+    addressMask = quirks.xoChip ? 0xFFFF : 0xFFF;
+    jit.reset();
+    decodeCache.assign(addressMask + 1u, decoded_t()); // One entry per address the platform can reach
+}
+
+uint32_t Chip8::run(uint32_t count)
+{
+    if (quirks.bits() != activeQuirks)
+    {
+        applyQuirks(); // Quirks were changed after load, once per run rather than per instruction
+    }
+    if (!skipIdle)
+    {
+        return runInterpreter(count);
+    }
+    uint16_t keys = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        keys |= keypad[i] << i;
+    }
+    if (keys != idleKeys)
+    {
+        idleKeys = keys;
+        idleBackoff = IDLE_MIN_BACKOFF; // The ROM is probably about to react, look again straight away
+        idleCountdown = 0;
+    }
+    uint32_t executed = 0;
+    while (executed < count && state != STOPPED)
+    {
+        if (idleCountdown == 0)
+        {
+            uint32_t period = 0;
+            executed += probeIdle(count - executed, period);
+            if (period)
+            {
+                // Every further iteration leaves the machine as it was, count them as run without running them
+                uint32_t skipped = (count - executed) / period * period;
+                executed += skipped;
+                idleInstructions += skipped;
+                idleBackoff = IDLE_MIN_BACKOFF;
+            }
+            continue;
+        }
+        uint32_t ran = runInterpreter(std::min(count - executed, idleCountdown));
+        if (ran == 0)
+        {
+            break;
+        }
+        idleCountdown -= ran;
+        executed += ran;
+    }
+    return executed;
+}
+
+uint32_t Chip8::probeIdle(uint32_t budget, uint32_t &period)
+{
+    // Step one instruction at a time looking for the machine to come back to exactly the state it
+    // started in. Keypad and timers only change between runs, so from then on it would just repeat.
+    // Memory writes and drawing are not tracked in the snapshot, either one ends the probe.
+    const uint8_t *live = reinterpret_cast<const uint8_t *>(static_cast<const Chip8State *>(this)) + IDLE_STATE_OFFSET;
+    uint8_t start[sizeof(Chip8State) - IDLE_STATE_OFFSET];
+    memcpy(start, live, sizeof(start));
+    uint64_t savedDirtyRows = dirtyRows;
+    uint32_t writes = memoryWrites;
+    dirtyRows = 0;
+    uint32_t executed = 0;
+    bool busy = false; // Changed memory or the display, or no repeat within IDLE_MAX_PERIOD
+    while (executed < budget && state != STOPPED)
+    {
+        executed += runInterpreter(1);
+        if (dirtyRows || memoryWrites != writes || executed >= IDLE_MAX_PERIOD)
+        {
+            busy = true;
+            break;
+        }
+        if (memcmp(start, live, sizeof(start)) == 0)
+        {
+            period = executed;
+            break;
+        }
+    }
+    if (busy)
+    {
+        idleCountdown = idleBackoff; // Leave it a while, backing off further each time
+        idleBackoff = std::min(idleBackoff * 2, IDLE_MAX_BACKOFF);
+    }
+    dirtyRows |= savedDirtyRows;
+    return executed;
+}
+
+uint32_t Chip8::runInterpreter(uint32_t count)
+{
+    bool instrumented = false;
+#if SDL_C8_PROFILER
+    instrumented = profiler != nullptr; // Only the two loops below count instructions
+#endif
+    // The JIT only knows the 4KB platforms, XO-CHIP programs get the threaded interpreter instead
+    if (interpreter == JIT && Chip8Jit::available() && !instrumented && !quirks.xoChip)
+    {
+        if (!jit)
+        {
+            jit = std::make_unique<Chip8Jit>();
+        }
+        return jit->run(*this, count);
+    }
+    if ((interpreter == THREADED || interpreter == JIT) && !instrumented)
+    {
+        return (this->*threadedRunner)(count);
+    }
+    uint32_t executed = 0;
+    while (executed < count && state != STOPPED)
+    {
+        if (interpreter == UNCACHED)
+            emulateInstructionUncached();
+        else
+            emulateInstruction();
+        ++executed;
+    }
+#if SDL_C8_PROFILER
+    if (profiler) profiler->instructions.fetch_add(executed, std::memory_order_relaxed);
+#endif
+    return executed;
+}
 void Chip8::loadRom(const std::string &romPath)
+{
+    std::vector<uint8_t> rom = readRom(romPath);
+    loadRom(rom.data(), rom.size());
+}
+
+std::vector<uint8_t> Chip8::readRom(const std::string &romPath)
 {
     std::ifstream romFile(romPath, std::ios::binary | std::ios::ate);
     if (!romFile.is_open()) {
@@ -111,131 +237,377 @@ void Chip8::loadRom(const std::string &romPath)
     }
     std::streamsize romSize = romFile.tellg();
     romFile.seekg(0, std::ios::beg);
-    if (romSize > (4096 - 0x200)) {
+    if (romSize > static_cast<std::streamsize>(sizeof(Chip8State::memory) - 0x200)) {
         throw std::runtime_error("ROM too large to fit in memory");
     }
-    romFile.read(reinterpret_cast<char*>(memory + 0x200), romSize);
-    romFile.close();
+    std::vector<uint8_t> rom(static_cast<size_t>(romSize));
+    romFile.read(reinterpret_cast<char*>(rom.data()), romSize);
+    return rom;
 }
 
-void Chip8::updatec8display()
+void Chip8::reset(const uint8_t *rom, size_t romSize)
 {
-    if (highResDisplay)
+    if (romSize > sizeof(memory) - 0x200) {
+        throw std::runtime_error("ROM too large to fit in memory"); // Checked before anything is cleared, a bad ROM leaves the old one running
+    }
+    static const Chip8State powerOn = Chip8State();
+    static_cast<Chip8State&>(*this) = powerOn;
+    initialise();
+    dirtyRows = ~0ull;
+    state = RUNNING;
+    trap = trapRecord();
+    soundChanged = true;
+    idleInstructions = 0;
+    idleCountdown = 0;
+    idleBackoff = IDLE_MIN_BACKOFF;
+    idleKeys = 0;
+    loadRom(rom, romSize);
+}
+
+void Chip8::reset(const std::string &romPath)
+{
+    std::vector<uint8_t> rom = readRom(romPath);
+    reset(rom.data(), rom.size());
+    currentRom = romPath;
+}
+
+void Chip8::loadRom(const uint8_t *rom, size_t romSize)
+{
+    if (romSize > sizeof(memory) - 0x200) {
+        throw std::runtime_error("ROM too large to fit in memory"); // Only XO-CHIP can reach past 4KB, the rest is loaded but unused
+    }
+    memcpy(memory + 0x200, rom, romSize);
+    romHash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < romSize; ++i)
     {
-        int x = V[currentInstruction.x] & 0x7F; // Mask to 0-127
-        int y = V[currentInstruction.y] & 0x3F; // Mask to 0-63
-        V[0xF] = 0; // Clear collision flag
+        romHash = (romHash ^ memory[0x200 + i]) * 0x100000001B3ull;
+    }
+    applyQuirks(); // New program, drop every decoded entry and compiled block rather than treating it as self-modification
+}
 
-        if (currentInstruction.n == 0) 
+namespace
+{
+    // Each bit of a byte doubled, so a low-res sprite row becomes its 16-pixel high-res row with one lookup
+    struct spreadTable
+    {
+        uint16_t bits[256];
+        spreadTable()
         {
-            for (int row = 0; row < 16; row++) 
+            for (int byte = 0; byte < 256; ++byte)
             {
-                uint8_t a1 = memory[I + row * 2];
-                uint8_t a2 = memory[I + row * 2 + 1];
-                uint16_t merged = (a1 << 8) | a2;
-                bool rowCollision = false;
-                for (int col = 0; col < 16; col++)
+                uint16_t spread = 0;
+                for (int bit = 0; bit < 8; ++bit)
                 {
-                    int pixel = (merged >> (15 - col)) & 1;
-                    int displayX = (x + col); // wrap if needed
-                    int displayY = (y + row);  // wrap if needed
-                    if (pixel == 0 || displayX >= 128 || displayY >= 64) continue; // Skip if pixel is off or values are out of bounds
-
-                    if (display[displayX][displayY] && pixel) rowCollision = true;
-                    display[displayX][displayY] ^= pixel;
+                    if (byte & (1 << bit))
+                        spread |= 3 << (bit * 2);
                 }
-                
-                if (rowCollision) V[0xF]++;
+                bits[byte] = spread;
             }
         }
+    };
+    const spreadTable spread;
+}
+
+bool Chip8::drawSpriteRow(int plane, int y, int x, uint64_t sprite, bool wrap)
+{
+    // Line the sprite up with the two 64-bit words of the row, pixels past column 127 fall off the end
+    uint64_t left = x < 64 ? sprite >> x : 0;
+    uint64_t right = x == 0 ? 0 : x < 64 ? sprite << (64 - x) : sprite >> (x - 64);
+    if (wrap && x > 64)
+    {
+        left |= sprite << (128 - x); // or come back in at column 0
+    }
+    uint64_t *row = display[plane][y];
+    dirtyRows |= 1ull << y;
+    bool collision = (row[0] & left) | (row[1] & right);
+    row[0] ^= left;
+    row[1] ^= right;
+    return collision;
+}
+
+void Chip8::scrollVertical(int pixels)
+{
+    // Whole packed rows move, so this is one memmove per plane. Low-res pixels are two rows tall.
+    int rows = highResDisplay || quirks.halfScroll ? pixels : pixels * 2;
+    int distance = std::min(std::abs(rows), 64);
+    for (int plane = 0; plane < DISPLAY_PLANES; ++plane)
+    {
+        if (!(planeMask & (1 << plane)))
+            continue;
+        uint64_t (*rowsOf)[2] = display[plane];
+        if (rows > 0)
+        {
+            memmove(rowsOf[distance], rowsOf[0], (64 - distance) * sizeof(rowsOf[0]));
+            memset(rowsOf[0], 0, distance * sizeof(rowsOf[0]));
+        }
         else
         {
-            for (int row = 0; row < currentInstruction.n; row++) 
+            memmove(rowsOf[0], rowsOf[distance], (64 - distance) * sizeof(rowsOf[0]));
+            memset(rowsOf[64 - distance], 0, distance * sizeof(rowsOf[0]));
+        }
+    }
+    dirtyRows = ~0ull;
+}
+
+void Chip8::scrollHorizontal(int pixels)
+{
+    // Each row is two words, shift both and carry the bits that cross between them
+    int shift = highResDisplay || quirks.halfScroll ? pixels : pixels * 2;
+    for (int plane = 0; plane < DISPLAY_PLANES; ++plane)
+    {
+        if (!(planeMask & (1 << plane)))
+            continue;
+        for (uint64_t *row : display[plane])
+        {
+            if (shift > 0)
             {
-                uint8_t byte = memory[I + row];
-                bool rowCollision = false;
-                for (int col = 0; col < 8; col++) 
-                {
-                    int pixel = (byte >> (7 - col)) & 1;
-                    int displayX = (x + col);
-                    int displayY = (y + row);
-                    if (pixel == 0 || displayX >= 128 || displayY >= 64) continue; // Skip if pixel is off or values are out of bounds
-                    if (pixel && display[displayX][displayY]) rowCollision = true; // Set collision flag
-                    display[displayX][displayY] ^= pixel;
-                }
-                if (rowCollision) V[0xF]++; // Increment collision flag if any pixel was toggled off
+                row[1] = row[1] >> shift | row[0] << (64 - shift);
+                row[0] >>= shift;
+            }
+            else
+            {
+                row[0] = row[0] << -shift | row[1] >> (64 + shift);
+                row[1] <<= -shift;
             }
         }
     }
-    else
+    dirtyRows = ~0ull;
+}
+
+template <bool Wrap>
+void Chip8::drawSprite()
+{
+    V[0xF] = 0; // Clear collision flag
+    unsigned used = 0;
+    for (int plane = 0; plane < DISPLAY_PLANES; ++plane)
     {
-        int x = V[currentInstruction.x] & 0x3F; // Mask to 0-63
-        int y = V[currentInstruction.y] & 0x1F; // Mask to 0-31
-        V[0xF] = 0; // Clear collision flag
+        if (planeMask & (1 << plane))
+        {
+            used += drawPlane<Wrap>(plane, uint16_t(I + used)); // Each selected plane takes the next sprite's worth of bytes
+        }
+    }
+    checkRange(I, used);
+}
 
-        for (int row = 0; row < currentInstruction.n; row++) 
+template <bool Wrap>
+uint16_t Chip8::drawPlane(int plane, uint16_t address)
+{
+    // Without wrapping rows past the bottom edge are dropped, with it they continue from the top
+    if (highResDisplay)
+    {
+        int x = V[currentInstruction.x] & 0x7F; // Mask to 0-127
+        int y = V[currentInstruction.y] & 0x3F; // Mask to 0-63
+
+        if (currentInstruction.n == 0) 
         {
-            uint8_t byte = memory[I + row];
-            for (int col = 0; col < 8; col++) 
+            // 16x16 sprite, two bytes per row
+            for (int row = 0; row < 16 && (Wrap || y + row < 64); row++) 
             {
-                int pixel = (byte >> (7 - col)) & 1;
-                int baseX = (x + col);
-                int baseY = (y + row);
-                if (baseX >= 64 || baseX < 0) continue;
-                if (baseY >= 32 || baseY < 0) continue;
-                // Scale low-res pixel to 2x2 in high-res display
-                for (int dy = 0; dy < 2; dy++)
-                {
-                    for (int dx = 0; dx < 2; dx++)
-                    {
-                        int displayX = (baseX * 2 + dx) % 128;
-                        int displayY = (baseY * 2 + dy) % 64;
-                        
-                        // Toggle pixel
-                        if (pixel && display[displayX][displayY] && dy == 0) 
-                        {
-                            V[0xF] = 1; // Set collision flag if pixel was already on in the top row
-                        }
-                        display[displayX][displayY] ^= pixel;
-                    }
-                }
+                uint64_t merged = (memory[(address + row * 2) & addressMask] << 8) | memory[(address + row * 2 + 1) & addressMask];
+                if (drawSpriteRow(plane, (y + row) & 63, x, merged << 48, Wrap)) V[0xF]++; // Count rows with a collision
             }
+            return 32;
+        }
+        for (int row = 0; row < currentInstruction.n && (Wrap || y + row < 64); row++) 
+        {
+            uint64_t byte = memory[(address + row) & addressMask];
+            if (drawSpriteRow(plane, (y + row) & 63, x, byte << 56, Wrap)) V[0xF]++;
         }
+        return currentInstruction.n;
+    }
+
+    int x = V[currentInstruction.x] & 0x3F; // Mask to 0-63
+    int y = V[currentInstruction.y] & 0x1F; // Mask to 0-31
+
+    // Each low-res pixel is a 2x2 block: spread the row to 16 bits and draw it on both high-res rows.
+    // XO-CHIP draws Dxy0 as a 16x16 sprite here too, its two bytes per row spread to 32 bits.
+    bool wide = currentInstruction.n == 0 && quirks.xoChip;
+    int rows = wide ? 16 : currentInstruction.n;
+    for (int row = 0; row < rows && (Wrap || y + row < 32); row++) 
+    {
+        uint64_t sprite;
+        if (wide)
+        {
+            sprite = static_cast<uint64_t>(spread.bits[memory[(address + row * 2) & addressMask]]) << 48
+                | static_cast<uint64_t>(spread.bits[memory[(address + row * 2 + 1) & addressMask]]) << 32;
+        }
+        else
+        {
+            sprite = static_cast<uint64_t>(spread.bits[memory[(address + row) & addressMask]]) << 48;
+        }
+        int top = ((y + row) & 31) * 2;
+        if (drawSpriteRow(plane, top, x * 2, sprite, Wrap))
+        {
+            V[0xF] = 1; // Collisions are only checked on the top row of each block
+        }
+        drawSpriteRow(plane, top + 1, x * 2, sprite, Wrap);
+    }
+    return wide ? 32 : currentInstruction.n;
+}
+
+void Chip8::updatec8display()
+{
+    drawSprite<false>();
+}
+
+void Chip8::updatec8displayWrapping()
+{
+    drawSprite<true>();
+}
+
+uint64_t Chip8::displayHash() const
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(display);
+    for (size_t i = 0; i < sizeof(display); ++i)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
     }
+    return hash;
 }
 
-SDL_Texture *Chip8::getDisplayTexture() const
+uint64_t Chip8::stateHash() const
 {
-    int width = 128;
-    int height = 64;
-    SDL_Texture *texture = SDL_CreateTexture(SDL_MainComponents::renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC, width, height);
-    SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_NEAREST);           
-    uint32_t pixels[width * height];
-    for (int y = 0; y < height; y++)
+    // FNV-1a a word at a time over the large arrays, so hashing every frame stays cheap.
+    // Fields are hashed one by one rather than the whole Chip8State to stay clear of padding.
+    uint64_t hash = 0xCBF29CE484222325ull;
+    auto words = [&hash](const void *data, size_t size)
     {
-        for (int x = 0; x < width; x++)
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i + 8 <= size; i += 8)
         {
-            int i = y * width + x;
-            pixels[i] = display[x][y] ? 0xFFFFFFFF : 0x00000000; // White for on, black for off
+            uint64_t word;
+            memcpy(&word, bytes + i, 8);
+            hash = (hash ^ word) * 0x100000001B3ull;
         }
+    };
+    words(memory, sizeof(memory));
+    words(display, sizeof(display));
+    words(V, sizeof(V));
+    uint64_t registers[2] = {
+        uint64_t(I) | uint64_t(pc) << 16 | uint64_t(delayTimer) << 32 | uint64_t(soundTimer) << 40 | uint64_t(sp) << 48,
+        uint64_t(rngState) | uint64_t(highResDisplay) << 32 | uint64_t(waitingForKeyRelease) << 40 | uint64_t(uint8_t(lastkeyPressed)) << 48 };
+    words(registers, sizeof(registers));
+    words(audioPattern, sizeof(audioPattern));
+    uint64_t sound = uint64_t(pitch) | uint64_t(patternLoaded) << 8 | uint64_t(planeMask) << 16;
+    words(&sound, sizeof(sound));
+    uint16_t liveStack[16] = {}; // Slots above sp are stale
+    memcpy(liveStack, stack, sp * sizeof(stack[0]));
+    words(liveStack, sizeof(liveStack));
+    return hash;
+}
+
+std::string trapRecord::describe() const
+{
+    static const char *const names[] = { "No trap", "Unknown opcode", "Stack overflow", "Stack underflow", "Address out of range" };
+    char line[96];
+    snprintf(line, sizeof(line), "%s: opcode %04X at %03X", names[kind], opcode, pc);
+    std::string text = line;
+    if (count > 1)
+    {
+        text += " (" + std::to_string(count) + " traps since the last report)";
     }
-    SDL_UpdateTexture(texture, nullptr, pixels, width * sizeof(uint32_t));
-    return texture;
+    return text;
 }
 
 Chip8::Chip8(const std::string &romPath)
 {
-    beeper = SDLBeep();
+    initialise();
+    currentRom = romPath;
+    loadRom(romPath);
+}
+
+Chip8::Chip8(const std::vector<uint8_t> &rom)
+{
+    initialise();
+    loadRom(rom.data(), rom.size());
+}
+
+void Chip8::initialise()
+{
     memset(display, 0, sizeof(display));
     memset(memory, 0, sizeof(memory));
     memset(V, 0, sizeof(V));
     memset(keypad, 0, sizeof(keypad));
+    decodeCache.assign(addressMask + 1u, decoded_t());
     I = 0;
-    currentRom = romPath;
+    delayTimer = 0;
+    soundTimer = 0;
     highResDisplay = false;
-    loadRom(romPath);
     pc = 0x200; // Program starts at 0x200
     // Load font into memory starting at 0x50
     memcpy(memory + 0x50, font, sizeof(font));
     memcpy(memory + 0x50 + sizeof(font), superFont, sizeof(superFont)); // Load Super Chip-8 font
-}
\ No newline at end of file
+}
+Chip8::~Chip8() = default;
+
+bool Chip8::loadState(const saveState_t &in)
+{
+    if (in.magic != saveState_t::MAGIC || in.version != saveState_t::VERSION || in.size != sizeof(Chip8State))
+    {
+        return false;
+    }
+    restoreState(in.state);
+    return true;
+}
+
+void Chip8::restoreState(const Chip8State &state)
+{
+    static_cast<Chip8State&>(*this) = state;
+    jit.reset(); // Memory may hold different code, drop compiled blocks and cached decodes
+    decodeCache.assign(decodeCache.size(), decoded_t());
+    dirtyRows = ~0ull;
+    soundChanged = true;
+}
+
+void Chip8::startRollBack()
+{
+    rollBackWrites.clear();
+    rollBackOverflow = false;
+    recordWrites = true;
+}
+
+void Chip8::rollBack(const Chip8State &state)
+{
+    recordWrites = false;
+    if (rollBackOverflow)
+    {
+        restoreState(state); // Too many writes to undo one by one
+        return;
+    }
+    memcpy(display, state.display, sizeof(display));
+    uint8_t *live = reinterpret_cast<uint8_t *>(static_cast<Chip8State *>(this)) + IDLE_STATE_OFFSET;
+    memcpy(live, reinterpret_cast<const uint8_t *>(&state) + IDLE_STATE_OFFSET, sizeof(Chip8State) - IDLE_STATE_OFFSET);
+    // Only the bytes written since startRollBack can differ, put them back and drop what was decoded or compiled from them
+    for (const writeRange &write : rollBackWrites)
+    {
+        for (uint16_t i = 0; i < write.length; ++i)
+        {
+            uint16_t address = (write.address + i) & addressMask;
+            memory[address] = state.memory[address];
+        }
+        invalidateDecodeCache(write.address, write.length);
+    }
+    rollBackWrites.clear();
+    dirtyRows = ~0ull; // What was last published is the run-ahead display, the next publish must compare against the real one
+}
+
+bool Chip8::saveStateFile(const std::string &path) const
+{
+    saveState_t snapshot;
+    saveState(snapshot);
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&snapshot), sizeof(snapshot));
+    return static_cast<bool>(file);
+}
+
+bool Chip8::loadStateFile(const std::string &path)
+{
+    saveState_t snapshot;
+    std::ifstream file(path, std::ios::binary);
+    if (!file.read(reinterpret_cast<char*>(&snapshot), sizeof(snapshot)))
+    {
+        return false;
+    }
+    return loadState(snapshot);
+}
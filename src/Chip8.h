@@ -2,10 +2,15 @@
 #include <cstdint>
 #include <fstream>
 #include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
 #include <vector>
-#include <SDL3/SDL_render.h>
-#include "SDLBeep.h"
-#include "Opcodes.h" 
+#include "Chip8IO.h"
+#include "Configuration.h"
+#include "Jit.h"
+#include "Opcodes.h"
+#include "Profiler.h"
 
 struct instruction_t
 {
@@ -30,34 +35,161 @@ struct instruction_t
         {}
 };
 
-class Chip8
+struct decoded_t
+{
+    instruction_t instruction; // Pre-split operands
+    OpcodeHandler handler = nullptr; // Leaf handler, nullptr when the entry needs decoding
+    const void* target = nullptr; // Threaded interpreter label, nullptr when the entry needs decoding
+    instruction_t next; // Second instruction of a fused pair, unused otherwise
+};
+
+enum trapKind : uint8_t
+{
+    TRAP_NONE,
+    TRAP_UNKNOWN_OPCODE,
+    TRAP_STACK_OVERFLOW, // 2nnn with all 16 levels in use, execution stops
+    TRAP_STACK_UNDERFLOW, // 00EE with nothing to return to, execution stops
+    TRAP_BAD_ADDRESS // I + length ran past the addressable memory, the access wrapped around
+};
+
+// Faults the ROM caused, kept by the interpreter instead of printed so a ROM that faults every
+// frame costs a counter increment. The host collects them with Chip8::takeTrap and logs them.
+struct trapRecord
+{
+    trapKind kind = TRAP_NONE; // The first trap since the last takeTrap
+    uint16_t pc = 0; // Address of the instruction that trapped
+    uint16_t opcode = 0;
+    uint32_t count = 0; // Every trap since the last takeTrap, including the first
+
+    std::string describe() const; // One line for the host's log
+};
+
+// Everything a save state captures. Kept trivially copyable with a fixed layout so a snapshot
+// is one memcpy, host-side state (devices, caches, keypad, quirks) lives in Chip8 instead.
+constexpr int DISPLAY_PLANES = 2; // XO-CHIP bitplanes, CHIP-8 and SUPER-CHIP only ever draw to the first
+
+struct Chip8State
+{
+    uint64_t display[DISPLAY_PLANES][64][2]; // A row-major 128x64 bitmap per plane, bit 63 of word 0 is the leftmost pixel of a row
+    uint8_t memory[0x10000]; // 64KB for XO-CHIP, the other platforms only address the first 4KB
+    uint16_t stack[16]; // Return addresses, stack[sp - 1] is the top
+    uint8_t sp = 0; // Stack depth
+    uint8_t V[16]; // 16 registers (V0 to VF)
+    uint16_t I; // Index register
+    uint8_t delayTimer; // Delay timer
+    uint8_t soundTimer; // Sound timer
+    uint16_t pc; // Program counter - current instruction address
+    bool highResDisplay = false; // Flag for high-resolution display
+    bool waitingForKeyRelease = false; // Fx0A saw a key go down and waits for it to come back up
+    int8_t lastkeyPressed = -1; // Key Fx0A is waiting on
+    uint32_t rngState = 0x2545F491; // xorshift32 state for Cxnn, never zero
+    uint8_t audioPattern[16] = {}; // XO-CHIP F002 sound, 128 one-bit samples played most significant bit first
+    uint8_t pitch = 64; // XO-CHIP Fx3A, the pattern plays at 4000 * 2^((pitch - 64) / 48) bits per second
+    bool patternLoaded = false; // F002 has run, until then the tone is the classic square wave
+    uint8_t planeMask = 1; // XO-CHIP Fn01, bit p selects plane p for drawing, clearing and scrolling
+    // Idle loop detection compares every field from stack down, new machine state belongs here too
+};
+static_assert(std::is_trivially_copyable<Chip8State>::value, "save states are copied with memcpy");
+
+// On-disk and in-memory save state: a header followed by the raw Chip8State
+struct saveState_t
+{
+    static constexpr uint32_t MAGIC = 0x53384843; // "CH8S"
+    static constexpr uint16_t VERSION = 3; // Bump whenever Chip8State changes layout
+    uint32_t magic = MAGIC;
+    uint16_t version = VERSION;
+    uint16_t reserved = 0;
+    uint32_t size = sizeof(Chip8State);
+    uint32_t reserved2 = 0;
+    Chip8State state;
+};
+
+class Chip8 : public Chip8State
 {
     public:
-        uint8_t memory[4096]; // 4KB of memory
-        bool display[128][64];
-        //bool highResDisplay[128 * 64]; // High-resolution display for Super Chip-8
-        std::vector<uint16_t> stack; // Chip8 stack using vector
-        uint8_t V[16]; // 16 registers (V0 to VF)
-        uint16_t I; // Index register
-        uint8_t delayTimer; // Delay timer
-        uint8_t soundTimer; // Sound timer
-        uint16_t pc; // Program counter - current instruction address
+        uint64_t dirtyRows = ~0ull; // Bit y set when display row y changed since the frontend last uploaded it
         std::string currentRom; // Current ROM being executed
-        bool highResDisplay = false; // Flag for high-resolution display
         bool keypad[16]; // 16 keys for input (0x0 to 0xF)
+        Quirks quirks; // Platform behaviour for this instance
+        void saveState(saveState_t& out) const { out = saveState_t(); out.state = *this; }
+        bool loadState(const saveState_t& in); // False if the header does not match this build
+        void restoreState(const Chip8State& state);
+        void startRollBack(); // Record memory writes from here on so rollBack can undo just those
+        void rollBack(const Chip8State& state); // Back to state, saved at startRollBack, keeping decoded and compiled code nothing wrote over
+        bool saveStateFile(const std::string& path) const;
+        bool loadStateFile(const std::string& path);
+        void seedRandom(uint32_t seed) { rngState = seed ? seed : 0x2545F491; }
+        uint8_t nextRandom()
+        {
+            rngState ^= rngState << 13;
+            rngState ^= rngState >> 17;
+            rngState ^= rngState << 5;
+            return rngState >> 24;
+        }
+        uint64_t displayHash() const; // FNV-1a over the framebuffer
+        uint64_t stateHash() const; // Hash of everything in Chip8State, for comparing runs frame by frame
+        uint64_t romHash = 0; // FNV-1a of the loaded ROM image
         void updateTimers();
         void handleInput();
         void emulateInstruction();
+        void emulateInstructionUncached(); // Reference fetch/decode path, bypasses the decode cache
+        void invalidateDecodeCache(uint16_t address, uint16_t length);
+        uint32_t run(uint32_t count); // Execute up to count instructions with the selected interpreter, returns how many ran
+        using threadedRunFn = uint32_t (Chip8::*)(uint32_t count);
+        template <unsigned QuirkBits> uint32_t runThreaded(uint32_t count); // Defined and instantiated in ThreadedInterpreter.cpp
+        static threadedRunFn threadedFor(unsigned quirkBits);
+        void applyQuirks(); // Select the interpreters specialised for quirks, done at load and whenever run sees quirks changed
         void loadRom(const std::string& romPath);
-        void updatec8display();
-        SDL_Texture* getDisplayTexture() const;
+        void loadRom(const uint8_t* rom, size_t romSize); // Copy a ROM image in at 0x200
+        static std::vector<uint8_t> readRom(const std::string& romPath); // Throws when it cannot be opened or does not fit
+        void reset(const uint8_t* rom, size_t romSize); // Back to power-on with a new ROM, keeping quirks, interpreter and host devices
+        void reset(const std::string& romPath);
+        void updatec8display(); // Dxyn, sprites clip at the edges
+        void updatec8displayWrapping(); // Dxyn, sprites wrap around to the opposite edge
+        bool drawSpriteRow(int plane, int y, int x, uint64_t sprite, bool wrap = false); // XOR a left-aligned sprite row in, returns true on collision
+        void scrollVertical(int pixels); // 00Cn/00Dn on the selected planes, positive scrolls down
+        void scrollHorizontal(int pixels); // 00FB/00FC on the selected planes, positive scrolls right
+        bool pixel(int x, int y, int plane = 0) const { return (display[plane][y][x >> 6] >> (63 - (x & 63))) & 1; }
+        trapRecord trap;
+        void raiseTrap(trapKind kind)
+        {
+            if (trap.count++ == 0)
+            {
+                trap.kind = kind;
+                trap.pc = pc - 2;
+                trap.opcode = currentInstruction.opcode;
+            }
+        }
+        void checkRange(uint16_t address, unsigned length) // Trap when address + length wraps, the access itself stays masked
+        {
+            if (address + length > addressMask + 1u)
+                raiseTrap(TRAP_BAD_ADDRESS);
+        }
+        bool takeTrap(trapRecord& out) { out = trap; trap = trapRecord(); return out.count != 0; }
+        void skipNext() // Taken skips step over the next instruction, F000 nnnn is the one four bytes long
+        {
+            pc += quirks.xoChip && memory[pc] == 0xF0 && memory[uint16_t(pc + 1)] == 0x00 ? 4 : 2;
+        }
         enum emulationState { RUNNING, PAUSED, STOPPED };
-        emulationState state;
-        SDLBeep beeper;
+        emulationState state = RUNNING;
+        enum interpreterMode { UNCACHED, CACHED, THREADED, JIT };
+        interpreterMode interpreter = CACHED;
+        AudioOutput* audio = nullptr; // Optional host devices, null when running headless
+        InputSource* input = nullptr;
+        Profiler* profiler = nullptr; // Optional, only fed in SDL_C8_PROFILER builds
+        bool skipIdle = true; // Count repeats of a loop that changes nothing as run instead of executing them
+        uint64_t idleInstructions = 0; // Instructions skipped that way so far
+        bool soundChanged = true; // XO-CHIP pattern or pitch not yet handed to audio, set by F002, Fx3A and restoreState
         instruction_t currentInstruction;
+        std::vector<decoded_t> decodeCache; // Indexed by pc, cleared whenever the covered bytes are written
+        std::unique_ptr<Chip8Jit> jit; // Created on first use of the JIT interpreter mode
+        unsigned activeQuirks = ~0u; // Quirks::bits the interpreters below were selected for
+        uint16_t addressMask = 0xFFF; // 0xFFFF on XO-CHIP, memory and decodeCache indices wrap with it
+        OpcodeDecoder decoder = &Opcodes::decode; // Fills decodeCache with handlers specialised for activeQuirks
+        threadedRunFn threadedRunner = nullptr;
         Chip8(const std::string& romPath);
-        bool waitingForKeyRelease = false;
-        int lastkeyPressed = -1;
+        Chip8(const std::vector<uint8_t>& rom); // ROM already in memory, for tools and tests that build their own
+        ~Chip8();
 
         // Shortcut method headers for instruction_t struct
         constexpr uint16_t opcode() { return currentInstruction.opcode; }
@@ -107,6 +239,29 @@ class Chip8
             0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0
         };
 
+    private:
+        void initialise(); // Clear the machine and load the fonts, shared by the constructors
+        uint32_t runInterpreter(uint32_t count);
+        uint32_t probeIdle(uint32_t budget, uint32_t& period); // Returns instructions run, sets period when idle
+        static constexpr uint32_t IDLE_MIN_BACKOFF = 64; // Instructions between probes while the ROM is busy
+        static constexpr uint32_t IDLE_MAX_BACKOFF = 8192;
+        uint32_t idleCountdown = 0; // Instructions until the next probe
+        uint32_t idleBackoff = IDLE_MIN_BACKOFF;
+        uint16_t idleKeys = 0; // Keypad at the last run, a change restarts probing
+        uint32_t memoryWrites = 0; // Bumped by invalidateDecodeCache
+        struct writeRange
+        {
+            uint16_t address;
+            uint16_t length;
+        };
+        static constexpr size_t ROLLBACK_MAX_WRITES = 256; // Beyond this rollBack restores everything instead
+        std::vector<writeRange> rollBackWrites; // Recorded by invalidateDecodeCache between startRollBack and rollBack
+        bool recordWrites = false;
+        bool rollBackOverflow = false;
+        template <bool Wrap> void drawSprite();
+        template <bool Wrap> uint16_t drawPlane(int plane, uint16_t address); // Returns the sprite bytes used
+
+    public:
         void (*opcodeTable[16])(Chip8&) = {
                 &Opcodes::handle0,
                 &Opcodes::handle1,
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+class Chip8; //Using forward declaration to avoid circular dependency
+
+// Small interfaces the core talks to instead of SDL. A headless Chip8 simply leaves them null.
+
+class AudioOutput
+{
+    public:
+        virtual ~AudioOutput() = default;
+        virtual void setSoundTimer(uint8_t ticks) = 0; // Called once per timer tick before the countdown, the tone lasts ticks/60 s from now
+        virtual void setPattern(const uint8_t* pattern, uint8_t pitch) = 0; // XO-CHIP 16-byte pattern and pitch, null for the classic beep
+};
+
+class InputSource
+{
+    public:
+        virtual ~InputSource() = default;
+        virtual void pollInput(Chip8& chip8) = 0; // Update chip8.keypad and chip8.state from pending host events
+};
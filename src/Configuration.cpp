@@ -1,13 +1,164 @@
 #include "Configuration.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <utility>
+#include <vector>
 
 namespace configuration
 {
-    bool vfReset = true;
-    bool clipping = true;
-    bool jumping = false;
-    int mode = 0; // 0 for CHIP-8, 1 for SCHIP-8 legacy, 2 for SCHIP-8 modern
+    uint32_t palette[4] = { DEFAULT_COLOR, 0xFFFFFFFF, 0xAAAAAAFF, 0x555555FF }; // Black, white, light and dark grey
+    std::string defaultProfile = "chip8";
+    std::string romIndexPath = "romindex.bin";
 }
 
-void configuration::readConfiguration(const char *filename)
+namespace
 {
-}
\ No newline at end of file
+    struct romOverride
+    {
+        std::string profile; // Empty keeps the default profile
+        std::vector<std::pair<std::string, bool>> quirks; // Individual quirks set on top of the profile
+    };
+
+    std::map<std::string, Quirks> builtinProfiles()
+    {
+        std::map<std::string, Quirks> profiles;
+        profiles["chip8"] = Quirks{ true, true, false, false, true };
+        profiles["schip-legacy"] = Quirks{ false, true, true, true, false, false, true };
+        profiles["schip-modern"] = Quirks{ false, true, true, true, false };
+        profiles["xo-chip"] = Quirks{ false, false, false, false, true, true };
+        return profiles;
+    }
+
+    std::map<std::string, Quirks> profiles = builtinProfiles();
+    std::map<std::string, romOverride> romOverrides; // Keyed by ROM file name
+
+    std::string lowercase(std::string text)
+    {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+        return text;
+    }
+
+    std::string trim(const std::string &text)
+    {
+        size_t first = text.find_first_not_of(" \t\r");
+        size_t last = text.find_last_not_of(" \t\r");
+        return first == std::string::npos ? "" : text.substr(first, last - first + 1);
+    }
+
+    bool parseBool(const std::string &value)
+    {
+        std::string lower = lowercase(value);
+        return lower == "true" || lower == "1" || lower == "yes" || lower == "on";
+    }
+
+    bool setQuirk(Quirks &quirks, const std::string &key, bool value)
+    {
+        std::string name = lowercase(key);
+        if (name == "vfreset") quirks.vfReset = value;
+        else if (name == "clipping") quirks.clipping = value;
+        else if (name == "jumping") quirks.jumping = value;
+        else if (name == "shifting") quirks.shifting = value;
+        else if (name == "memoryincrement") quirks.memoryIncrement = value;
+        else if (name == "xochip") quirks.xoChip = value;
+        else if (name == "halfscroll") quirks.halfScroll = value;
+        else return false;
+        return true;
+    }
+}
+
+bool configuration::profileQuirks(const std::string &profile, Quirks &quirks)
+{
+    auto found = profiles.find(lowercase(profile));
+    if (found == profiles.end())
+        return false;
+    quirks = found->second;
+    return true;
+}
+
+Quirks configuration::quirksForRom(const std::string &romPath, const std::string &profile)
+{
+    Quirks quirks;
+    profileQuirks(profile, quirks);
+    auto found = romOverrides.find(std::filesystem::path(romPath).filename().string());
+    if (found != romOverrides.end())
+    {
+        if (!found->second.profile.empty())
+            profileQuirks(found->second.profile, quirks);
+        for (const auto &setting : found->second.quirks)
+            setQuirk(quirks, setting.first, setting.second);
+    }
+    return quirks;
+}
+
+// Sections understood:
+//   [Emulator]           Mode = default profile name, Index = RomIndex file written by sdl-c8 --index
+//   [Display]            Background / Foreground / Plane2 / Overlap = RRGGBBAA hex, the four palette entries
+//   [Profile:<name>]     quirk = true/false, starts from the built-in profile of that name if there is one
+//   [Rom:<file name>]    Mode = profile, plus individual quirk = true/false overrides
+bool configuration::readConfiguration(const char *filename)
+{
+    std::ifstream file(filename);
+    if (!file)
+        return false;
+    std::string section;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        line = trim(line.substr(0, line.find_first_of(";#")));
+        if (line.empty())
+            continue;
+        if (line.front() == '[' && line.back() == ']')
+        {
+            section = trim(line.substr(1, line.size() - 2));
+            std::string lower = lowercase(section);
+            if (lower.rfind("profile:", 0) == 0)
+            {
+                std::string name = lowercase(trim(section.substr(8)));
+                profiles.emplace(name, Quirks()); // Keeps the built-in values when overriding a known profile
+            }
+            continue;
+        }
+        size_t equals = line.find('=');
+        if (equals == std::string::npos)
+            continue;
+        std::string key = trim(line.substr(0, equals));
+        std::string value = trim(line.substr(equals + 1));
+        std::string lowerSection = lowercase(section);
+        std::string lowerKey = lowercase(key);
+
+        if (lowerSection == "emulator" && lowerKey == "mode")
+        {
+            defaultProfile = lowercase(value);
+        }
+        else if (lowerSection == "emulator" && lowerKey == "index")
+        {
+            romIndexPath = value;
+        }
+        else if (lowerSection == "display")
+        {
+            static const char *const entries[4] = { "background", "foreground", "plane2", "overlap" };
+            for (int i = 0; i < 4; ++i)
+            {
+                if (lowerKey == entries[i])
+                    palette[i] = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 16));
+            }
+        }
+        else if (lowerSection.rfind("profile:", 0) == 0)
+        {
+            setQuirk(profiles[lowercase(trim(section.substr(8)))], key, parseBool(value));
+        }
+        else if (lowerSection.rfind("rom:", 0) == 0)
+        {
+            romOverride &rom = romOverrides[trim(section.substr(4))];
+            if (lowerKey == "mode")
+                rom.profile = lowercase(value);
+            else
+                rom.quirks.emplace_back(key, parseBool(value));
+        }
+    }
+    return true;
+}
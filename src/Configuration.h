@@ -1,15 +1,57 @@
+#pragma once
 #include <cstdint>
-#include <ini.h>
-#include <INIReader.h>
+#include <string>
+
+// Bit positions of each quirk in Quirks::bits. The ones below QUIRK_COMBINATIONS also select the
+// specialised interpreter, the rest are only read at run time.
+enum quirkBit : unsigned
+{
+    QUIRK_VF_RESET = 1u << 0,
+    QUIRK_CLIPPING = 1u << 1,
+    QUIRK_JUMPING = 1u << 2,
+    QUIRK_SHIFTING = 1u << 3,
+    QUIRK_MEMORY_INCREMENT = 1u << 4,
+    QUIRK_XO_CHIP = 1u << 5,
+    QUIRK_HALF_SCROLL = 1u << 6
+};
+constexpr unsigned QUIRK_COMBINATIONS = 1u << 6;
+
+// Behaviour that differs between CHIP-8 platforms, held per Chip8 instance
+struct Quirks
+{
+    bool vfReset = true; // 8xy1/8xy2/8xy3 reset VF
+    bool clipping = true; // Sprites clip at the screen edge instead of wrapping
+    bool jumping = false; // Bnnn jumps to nnn + Vx instead of nnn + V0
+    bool shifting = false; // 8xy6/8xyE shift Vx in place instead of shifting Vy into Vx
+    bool memoryIncrement = true; // Fx55/Fx65 leave I pointing past the last register touched
+    bool xoChip = false; // XO-CHIP extensions: 64KB addressing, F000 nnnn, 5xy2/5xy3, Fn01 plane select and 00Dn
+    bool halfScroll = false; // Low-res scrolls move by high-res pixels, half as far, like SUPER-CHIP 1.1
+
+    constexpr unsigned bits() const
+    {
+        return (vfReset ? unsigned(QUIRK_VF_RESET) : 0u) | (clipping ? unsigned(QUIRK_CLIPPING) : 0u) | (jumping ? unsigned(QUIRK_JUMPING) : 0u)
+            | (shifting ? unsigned(QUIRK_SHIFTING) : 0u) | (memoryIncrement ? unsigned(QUIRK_MEMORY_INCREMENT) : 0u) | (xoChip ? unsigned(QUIRK_XO_CHIP) : 0u)
+            | (halfScroll ? unsigned(QUIRK_HALF_SCROLL) : 0u);
+    }
+    static constexpr Quirks fromBits(unsigned bits)
+    {
+        return Quirks{ (bits & QUIRK_VF_RESET) != 0, (bits & QUIRK_CLIPPING) != 0, (bits & QUIRK_JUMPING) != 0,
+                       (bits & QUIRK_SHIFTING) != 0, (bits & QUIRK_MEMORY_INCREMENT) != 0, (bits & QUIRK_XO_CHIP) != 0,
+                       (bits & QUIRK_HALF_SCROLL) != 0 };
+    }
+};
+
 namespace configuration
 {
     constexpr int WINDOW_WIDTH = 128;
     constexpr int WINDOW_HEIGHT = 64;
     constexpr uint32_t DEFAULT_COLOR = 0x00000000; // Black in RGBA format
     constexpr int SCALE_FACTOR = 10;
-    extern bool vfReset;
-    extern bool clipping;
-    extern bool jumping;
-    extern int mode;
-    void readConfiguration(const char* filename);
-}
\ No newline at end of file
+    constexpr int INSTRUCTIONS_PER_FRAME = 700 / 60;
+    extern uint32_t palette[4]; // RGBA8888 indexed by the planes lit at a pixel: off, plane 1, plane 2, both
+    extern std::string defaultProfile; // Profile for ROMs without an override, [Emulator] Mode
+    extern std::string romIndexPath; // RomIndex consulted before defaultProfile, [Emulator] Index
+    bool profileQuirks(const std::string& profile, Quirks& quirks); // chip8, schip-legacy, schip-modern, xo-chip or one defined in the INI
+    Quirks quirksForRom(const std::string& romPath, const std::string& profile = defaultProfile); // profile plus any [Rom:<file name>] overrides
+    bool readConfiguration(const char* filename); // False if the file could not be opened, built-in defaults stay in place
+}
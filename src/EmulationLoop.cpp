@@ -0,0 +1,243 @@
+#include "EmulationLoop.h"
+#include <chrono>
+#include <cstring>
+
+EmulationLoop::EmulationLoop(Chip8 &chip8, FrameScheduler &scheduler)
+    : chip8(chip8), scheduler(scheduler)
+{
+}
+
+EmulationLoop::~EmulationLoop()
+{
+    stop();
+}
+
+uint64_t EmulationLoop::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool EmulationLoop::sendKey(uint8_t key, bool down)
+{
+    return events.push({ now(), static_cast<uint8_t>(key & 0xF), down });
+}
+
+bool EmulationLoop::loadRom(const romImage &rom)
+{
+    return roms.push(rom);
+}
+
+void EmulationLoop::start()
+{
+    thread = std::thread([this]
+    {
+        while (!quit.load(std::memory_order_relaxed) && !finished())
+        {
+            step();
+            scheduler.endFrame();
+        }
+    });
+}
+
+void EmulationLoop::stop()
+{
+    quit.store(true, std::memory_order_relaxed);
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+void EmulationLoop::step()
+{
+    bool advanced = false;
+    romImage rom;
+    if (roms.peek(rom))
+    {
+        roms.pop();
+        applyRom(rom);
+    }
+    scheduler.turbo = turbo.load(std::memory_order_relaxed);
+    int due = scheduler.beginFrame();
+    uint64_t windowEnd = now();
+    if (windowStart == 0)
+    {
+        windowStart = windowEnd;
+    }
+    if (chip8.state != Chip8::STOPPED)
+    {
+        chip8.state = paused.load(std::memory_order_relaxed) ? Chip8::PAUSED : Chip8::RUNNING;
+    }
+
+    if (rewinding.load(std::memory_order_relaxed) || chip8.state == Chip8::PAUSED)
+    {
+        applyPendingKeys(windowEnd); // Keys still track the host, there is just no frame to place them in
+        if (chip8.audio)
+        {
+            chip8.audio->setSoundTimer(0); // Timers are not ticking while paused or stepping back
+        }
+        for (int frame = 0; frame < due && chip8.state != Chip8::PAUSED && rewind && rewind->pop(chip8); ++frame)
+        {
+            if (movie && popsSinceCapture++ > 0)
+            {
+                movie->truncate(movie->header.frames - 1);
+            }
+        }
+        windowStart = windowEnd;
+    }
+    else if (due > 0)
+    {
+        // Spread the host time since the last emulated frame evenly over the frames due now
+        uint64_t span = (windowEnd - windowStart) / due;
+        for (int frame = 0; frame < due && chip8.state != Chip8::STOPPED; ++frame)
+        {
+            uint64_t frameStart = windowStart + span * frame;
+            emulateFrame(frameStart, frame == due - 1 ? windowEnd : frameStart + span);
+        }
+        windowStart = windowEnd;
+        advanced = true;
+    }
+    int ahead = runAhead.load(std::memory_order_relaxed);
+    if (ahead > 0 && advanced && chip8.state == Chip8::RUNNING)
+    {
+        publishAhead(ahead);
+    }
+    else
+    {
+        if (publishedAhead)
+        {
+            // Paused, rewinding or run-ahead switched off, the real state goes back on show
+            chip8.dirtyRows = ~0ull;
+            publishedAhead = 0;
+        }
+        publish();
+    }
+    if (chip8.trap.count && traps.push(chip8.trap))
+    {
+        chip8.trap = trapRecord(); // While the host is behind, further traps keep counting into the one it has not taken
+    }
+    if (chip8.state == Chip8::STOPPED)
+    {
+        stopped.store(true, std::memory_order_release);
+    }
+}
+
+void EmulationLoop::applyRom(const romImage &rom)
+{
+    // Same instance, same audio and display, only the machine goes back to power-on
+    uint32_t seed = chip8.rngState;
+    chip8.quirks = rom.quirks;
+    chip8.reset(rom.bytes.data(), rom.bytes.size());
+    chip8.currentRom = rom.path;
+    chip8.seedRandom(seed);
+    if (rom.instructionsPerFrame > 0)
+    {
+        scheduler.instructionsPerFrame = rom.instructionsPerFrame;
+    }
+    if (rewind)
+    {
+        rewind->clear(); // History from the old ROM would restore its memory over the new one
+    }
+    if (movie)
+    {
+        movie->start(chip8, static_cast<uint32_t>(scheduler.instructionsPerFrame));
+    }
+}
+
+void EmulationLoop::emulateFrame(uint64_t frameStart, uint64_t frameEnd)
+{
+    uint32_t ipf = static_cast<uint32_t>(scheduler.instructionsPerFrame);
+    uint64_t length = frameEnd > frameStart ? frameEnd - frameStart : 1;
+    uint32_t executed = 0;
+    inputEvent event;
+    while (events.peek(event) && event.timestamp < frameEnd)
+    {
+        uint32_t at = event.timestamp <= frameStart ? 0 : static_cast<uint32_t>((event.timestamp - frameStart) * ipf / length);
+        if (at > executed)
+        {
+            executed += chip8.run(at - executed);
+        }
+        events.pop();
+        applyKey(event, executed);
+    }
+    if (executed < ipf)
+    {
+        chip8.run(ipf - executed);
+    }
+    chip8.updateTimers();
+    ++emulatedFrames;
+    if (rewind)
+    {
+        rewind->push(chip8);
+    }
+    popsSinceCapture = 0;
+    if (movie)
+    {
+        movie->record(chip8);
+    }
+}
+
+void EmulationLoop::applyPendingKeys(uint64_t before)
+{
+    inputEvent event;
+    while (events.peek(event) && event.timestamp < before)
+    {
+        events.pop();
+        applyKey(event, 0);
+    }
+}
+
+void EmulationLoop::applyKey(const inputEvent &event, uint32_t instruction)
+{
+    if (chip8.keypad[event.key] == event.down)
+    {
+        return; // Key repeat
+    }
+    chip8.keypad[event.key] = event.down;
+    if (movie)
+    {
+        movie->keyChange(chip8, instruction);
+    }
+}
+
+void EmulationLoop::publishAhead(int frames)
+{
+    // Sound, rewind, the movie, the trap log and the profile only ever see real frames
+    aheadStart = chip8;
+    chip8.startRollBack();
+    trapRecord trap = chip8.trap;
+    AudioOutput *audio = chip8.audio;
+    Profiler *profiler = chip8.profiler;
+    uint64_t idle = chip8.idleInstructions;
+    uint32_t ipf = static_cast<uint32_t>(scheduler.instructionsPerFrame);
+    chip8.audio = nullptr;
+    chip8.profiler = nullptr;
+    for (int frame = 0; frame < frames && chip8.state == Chip8::RUNNING; ++frame)
+    {
+        chip8.run(ipf);
+        chip8.updateTimers();
+    }
+    publish();
+    publishedAhead = frames;
+    chip8.audio = audio;
+    chip8.profiler = profiler;
+    chip8.idleInstructions = idle;
+    chip8.trap = trap;
+    chip8.state = Chip8::RUNNING;
+    chip8.rollBack(aheadStart);
+}
+
+void EmulationLoop::publish()
+{
+    if (!chip8.dirtyRows && chip8.highResDisplay == publishedHighRes)
+    {
+        return; // Nothing drawn, the host keeps showing the last frame instead of rendering it again
+    }
+    chip8.dirtyRows = 0;
+    publishedHighRes = chip8.highResDisplay;
+    frameSnapshot &snapshot = frames.back();
+    memcpy(snapshot.display, chip8.display, sizeof(snapshot.display));
+    snapshot.highResDisplay = chip8.highResDisplay;
+    snapshot.frame = emulatedFrames;
+    frames.publish();
+}
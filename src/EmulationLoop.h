@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Chip8.h"
+#include "FrameScheduler.h"
+#include "Movie.h"
+#include "RewindBuffer.h"
+#include "SpscQueue.h"
+#include "TripleBuffer.h"
+
+// A finished frame as handed to the renderer
+struct frameSnapshot
+{
+    uint64_t display[DISPLAY_PLANES][64][2];
+    bool highResDisplay = false;
+    uint64_t frame = 0; // Emulated frames so far
+};
+
+struct inputEvent
+{
+    uint64_t timestamp; // EmulationLoop::now() when the host saw the event
+    uint8_t key; // Keypad index 0x0-0xF
+    bool down;
+};
+
+// A ROM read by the host, swapped into the running machine by EmulationLoop::loadRom
+struct romImage
+{
+    std::string path;
+    std::vector<uint8_t> bytes;
+    Quirks quirks;
+    int instructionsPerFrame = 0; // 0 keeps the scheduler's current rate
+};
+
+// Drives a Chip8 frame by frame under a FrameScheduler, either inline from the host loop (step)
+// or on its own thread (start). The host talks to it only through lock-free structures: keypad
+// events go in through an SPSC queue, finished frames come out through a triple buffer and the
+// host controls are atomics. Keypad events are timestamped, and each one is applied at the
+// instruction boundary matching where its timestamp falls within the emulated frame.
+// With runAhead set, what gets published is the display that many frames past the real state,
+// run with the keys as they are now and then rolled back, which hides the ROM's own input lag.
+class EmulationLoop
+{
+    public:
+        EmulationLoop(Chip8& chip8, FrameScheduler& scheduler);
+        ~EmulationLoop();
+        EmulationLoop(const EmulationLoop&) = delete;
+        EmulationLoop& operator=(const EmulationLoop&) = delete;
+
+        static uint64_t now(); // Steady clock in nanoseconds
+
+        // Host side
+        bool sendKey(uint8_t key, bool down); // False if the queue is full and the event was dropped
+        bool loadRom(const romImage& rom); // Reset onto rom at the start of the next step, false while another is still pending
+        void step(); // Run the frames that are due and publish the result, for the single-threaded mode
+        void start(); // Run step and the scheduler's wait on a dedicated thread
+        void stop();
+        bool finished() const { return stopped.load(std::memory_order_acquire); } // The ROM halted (00FD)
+
+        std::atomic<bool> rewinding{false};
+        std::atomic<bool> turbo{false};
+        std::atomic<bool> paused{false};
+        std::atomic<bool> quit{false};
+        std::atomic<int> runAhead{0}; // Frames the published display runs ahead of the emulated state
+        TripleBuffer<frameSnapshot> frames; // Only published when the display changed
+        SpscQueue<trapRecord, 16> traps; // Faults the ROM hit, for the host to log, at most one per step
+        RewindBuffer* rewind = nullptr; // Optional, owned by the caller and only touched by the emulating thread
+        Movie* movie = nullptr;
+
+    private:
+        void emulateFrame(uint64_t frameStart, uint64_t frameEnd);
+        void applyPendingKeys(uint64_t before); // Apply every queued event stamped earlier than before
+        void applyKey(const inputEvent& event, uint32_t instruction);
+        void publish();
+        void publishAhead(int frames); // Run frames on from a snapshot, publish that and roll back
+        void applyRom(const romImage& rom);
+
+        Chip8& chip8;
+        FrameScheduler& scheduler;
+        SpscQueue<inputEvent, 256> events;
+        SpscQueue<romImage, 2> roms;
+        std::thread thread;
+        std::atomic<bool> stopped{false};
+        uint64_t windowStart = 0; // Host time the next emulated frame starts covering
+        uint64_t emulatedFrames = 0;
+        bool publishedHighRes = false;
+        int popsSinceCapture = 0; // The first rewind pop after a capture restores the frame already shown
+        int publishedAhead = 0; // Run-ahead frames in the display last published
+        Chip8State aheadStart; // The real state while publishAhead runs past it
+};
@@ -0,0 +1,90 @@
+#include "FrameScheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace
+{
+    const std::chrono::microseconds SPIN_MARGIN(2000); // Sleep overshoot allowance, spun away instead
+}
+
+FrameScheduler::FrameScheduler(double hz)
+    : period(std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / hz)))
+{
+}
+
+int FrameScheduler::beginFrame()
+{
+    clock::time_point now = clock::now();
+    if (!started)
+    {
+        started = true;
+        nextFrame = now;
+    }
+    else
+    {
+        double ms = std::chrono::duration<double, std::milli>(now - lastBegin).count();
+        sumMs += ms;
+        sumSquaresMs += ms * ms;
+        if (ms > totals.maxMs)
+            totals.maxMs = ms;
+    }
+    lastBegin = now;
+    ++totals.loops;
+
+    if (turbo)
+    {
+        nextFrame = now; // Resume normal pacing from here, without a catch-up burst
+        totals.emulatedFrames += turboFrames;
+        return turboFrames;
+    }
+
+    int due = 0;
+    while (nextFrame <= now && due < MAX_CATCH_UP)
+    {
+        nextFrame += period;
+        ++due;
+    }
+    if (nextFrame <= now)
+    {
+        // Too far behind (debugger, window drag...), fast-forwarding through it would only stutter more
+        totals.droppedFrames += (now - nextFrame) / period + 1;
+        nextFrame = now + period;
+    }
+    if (due > 1)
+        totals.lateFrames += due - 1;
+    totals.emulatedFrames += due;
+    return due;
+}
+
+void FrameScheduler::endFrame()
+{
+    if (turbo || vsync)
+        return;
+    waitUntil(nextFrame);
+}
+
+void FrameScheduler::waitUntil(clock::time_point deadline)
+{
+    clock::time_point now = clock::now();
+    if (deadline - now > SPIN_MARGIN)
+    {
+        std::this_thread::sleep_for(deadline - now - SPIN_MARGIN);
+    }
+    while (clock::now() < deadline)
+    {
+        std::this_thread::yield();
+    }
+}
+
+frameStats FrameScheduler::stats() const
+{
+    frameStats result = totals;
+    uint64_t intervals = totals.loops > 1 ? totals.loops - 1 : 0;
+    if (intervals)
+    {
+        result.meanMs = sumMs / intervals;
+        result.jitterMs = std::sqrt(std::max(0.0, sumSquaresMs / intervals - result.meanMs * result.meanMs));
+    }
+    return result;
+}
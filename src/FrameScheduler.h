@@ -0,0 +1,48 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include "Configuration.h"
+
+struct frameStats
+{
+    uint64_t loops = 0; // Host frames, one per beginFrame
+    uint64_t emulatedFrames = 0;
+    uint64_t lateFrames = 0; // Emulated in a catch-up burst because a host frame ran long
+    uint64_t droppedFrames = 0; // Given up on after falling too far behind
+    double meanMs = 0; // Time between host frames
+    double maxMs = 0;
+    double jitterMs = 0; // Standard deviation of the time between host frames
+};
+
+// Paces the main loop to a fixed emulated frame rate. Emulated time advances in whole 60 Hz
+// steps against an absolute deadline, so a long frame is caught up on the next ones instead of
+// drifting. Waiting sleeps until shortly before the deadline and spins the rest, because sleep
+// alone overshoots by up to a millisecond or more. With VSync the renderer's present does the
+// waiting and the scheduler only counts how many steps are due.
+class FrameScheduler
+{
+    public:
+        FrameScheduler(double hz = 60.0);
+
+        int beginFrame(); // Emulated frames to run before the next present
+        void endFrame(); // Wait for the next deadline unless VSync or turbo is doing the pacing
+        frameStats stats() const;
+
+        int instructionsPerFrame = configuration::INSTRUCTIONS_PER_FRAME;
+        bool vsync = false; // Present blocks until the display refreshes
+        bool turbo = false; // Run uncapped, turboFrames emulated frames per present
+        int turboFrames = 8;
+
+    private:
+        using clock = std::chrono::steady_clock;
+        static constexpr int MAX_CATCH_UP = 4; // Beyond this many late frames the backlog is dropped
+        void waitUntil(clock::time_point deadline);
+
+        clock::duration period;
+        clock::time_point nextFrame;
+        clock::time_point lastBegin;
+        bool started = false;
+        frameStats totals;
+        double sumMs = 0;
+        double sumSquaresMs = 0;
+};
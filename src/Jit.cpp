@@ -0,0 +1,437 @@
+#include "Jit.h"
+#include <algorithm>
+#include <cstring>
+#include "Chip8.h"
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#define SDL_C8_JIT 1
+#endif
+
+namespace
+{
+    constexpr size_t CODE_BUFFER_SIZE = 1 << 20; // Flushed and reused when full
+    constexpr size_t MAX_BLOCK_BYTES = 4096; // Worst case machine code for one block
+    constexpr int MAX_BLOCK_LENGTH = 64; // CHIP-8 instructions per block
+
+    // Offsets of the fields generated code touches, relative to the Chip8* passed in rdi
+    struct chip8Offsets
+    {
+        int32_t V, I, pc, delayTimer, soundTimer, keypad;
+    };
+
+    chip8Offsets offsetsOf(Chip8& chip8)
+    {
+        const char* base = reinterpret_cast<const char*>(&chip8);
+        chip8Offsets o;
+        o.V = static_cast<int32_t>(reinterpret_cast<const char*>(chip8.V) - base);
+        o.I = static_cast<int32_t>(reinterpret_cast<const char*>(&chip8.I) - base);
+        o.pc = static_cast<int32_t>(reinterpret_cast<const char*>(&chip8.pc) - base);
+        o.delayTimer = static_cast<int32_t>(reinterpret_cast<const char*>(&chip8.delayTimer) - base);
+        o.soundTimer = static_cast<int32_t>(reinterpret_cast<const char*>(&chip8.soundTimer) - base);
+        o.keypad = static_cast<int32_t>(reinterpret_cast<const char*>(chip8.keypad) - base);
+        return o;
+    }
+
+    // Minimal x86-64 encoder for the handful of forms the translator needs.
+    // rdi = Chip8*, esi = instruction budget, r8d = instructions executed so far, eax/ecx/edx scratch.
+    // Registers are numbered as in the encoding, 0 = eax ... 15 = r15d.
+    struct emitter
+    {
+        std::vector<uint8_t> code;
+
+        void byte(uint8_t b) { code.push_back(b); }
+        void bytes(std::initializer_list<uint8_t> list) { code.insert(code.end(), list); }
+        void imm16(uint16_t v) { byte(v & 0xFF); byte(v >> 8); }
+        void imm32(uint32_t v) { for (int i = 0; i < 4; ++i) byte((v >> (8 * i)) & 0xFF); }
+
+        // REX prefix when an operand is r8-r15, or a byte operand would otherwise mean ah-bh
+        void rex(int reg, int rm, bool byteOperands)
+        {
+            if (reg >= 8 || rm >= 8 || (byteOperands && (reg >= 4 || rm >= 4)))
+                byte(0x40 | (reg >= 8 ? 4 : 0) | (rm >= 8 ? 1 : 0));
+        }
+        void direct(int reg, int rm) { byte(0xC0 | ((reg & 7) << 3) | (rm & 7)); }
+        // Memory operands are always [rdi + disp32], modrm reg field supplied by the caller
+        void mem(int reg, int32_t disp) { byte(0x80 | ((reg & 7) << 3) | 0x7); imm32(disp); }
+
+        void movzxRegMem8(int r, int32_t d) { rex(r, 0, false); bytes({0x0F, 0xB6}); mem(r, d); } // movzx r32, byte [rdi+d]
+        void movzxRegMem16(int r, int32_t d) { rex(r, 0, false); bytes({0x0F, 0xB7}); mem(r, d); } // movzx r32, word [rdi+d]
+        void movzxRegReg8(int r, int from) { rex(r, from, true); bytes({0x0F, 0xB6}); direct(r, from); } // movzx r32, r8
+        void movMemReg8(int32_t d, int r) { rex(r, 0, true); byte(0x88); mem(r, d); } // mov [rdi+d], r8
+        void movMemReg16(int32_t d, int r) { byte(0x66); rex(r, 0, false); byte(0x89); mem(r, d); } // mov [rdi+d], r16
+        void addMemReg16(int32_t d, int r) { byte(0x66); rex(r, 0, false); byte(0x01); mem(r, d); } // add [rdi+d], r16
+        void addRegReg16(int r, int from) { byte(0x66); rex(from, r, false); byte(0x01); direct(from, r); } // add r16, r16
+        void movRegImm(int r, uint32_t v) { rex(0, r, false); byte(0xB8 | (r & 7)); imm32(v); } // mov r32, v
+        void movMemImm8(int32_t d, uint8_t v) { byte(0xC6); mem(0, d); byte(v); } // mov byte [rdi+d], v
+        void movMemImm16(int32_t d, uint16_t v) { bytes({0x66, 0xC7}); mem(0, d); imm16(v); } // mov word [rdi+d], v
+        void addMemImm8(int32_t d, uint8_t v) { byte(0x80); mem(0, d); byte(v); } // add byte [rdi+d], v
+        void addRegImm8(int r, uint8_t v) { rex(0, r, true); byte(0x80); direct(0, r); byte(v); } // add r8, v
+        void cmpMemImm8(int32_t d, uint8_t v) { byte(0x80); mem(7, d); byte(v); } // cmp byte [rdi+d], v
+        void cmpRegImm8(int r, uint8_t v) { rex(0, r, true); byte(0x80); direct(7, r); byte(v); } // cmp r8, v
+        void cmpDlCl() { bytes({0x38, 0xCA}); }
+        void andEdxImm8(uint8_t v) { bytes({0x83, 0xE2}); byte(v); } // and edx, v
+        void cmpKeypadRdx(int32_t d) { bytes({0x80, 0xBC, 0x17}); imm32(d); byte(0); } // cmp byte [rdi+rdx+d], 0
+        void aluAlCl(uint8_t op) { byte(op); byte(0xC8); } // op al, cl (or 08, and 20, xor 30, add 00, sub 28)
+        void setcDl() { bytes({0x0F, 0x92, 0xC2}); }
+        void setncDl() { bytes({0x0F, 0x93, 0xC2}); }
+        void shrAl() { bytes({0xD0, 0xE8}); }
+        void shlAl() { bytes({0xD0, 0xE0}); }
+        void cmoveEaxEcx() { bytes({0x0F, 0x44, 0xC1}); }
+        void cmovneEaxEcx() { bytes({0x0F, 0x45, 0xC1}); }
+        void push(int r) { rex(0, r, false); byte(0x50 | (r & 7)); }
+        void pop(int r) { rex(0, r, false); byte(0x58 | (r & 7)); }
+        void xorR8d() { bytes({0x45, 0x31, 0xC0}); }
+        void addR8dImm(uint32_t v) { bytes({0x41, 0x81, 0xC0}); imm32(v); }
+        void leaEaxR8Imm(uint32_t v) { bytes({0x41, 0x8D, 0x80}); imm32(v); } // lea eax, [r8+v]
+        void movEaxR8d() { bytes({0x44, 0x89, 0xC0}); }
+        void cmpEaxEsi() { bytes({0x39, 0xF0}); }
+        size_t jaRel32() { bytes({0x0F, 0x87}); imm32(0); return code.size(); } // Returns the patch point
+        void jmpTo(size_t target) { byte(0xE9); imm32(static_cast<uint32_t>(target - (code.size() + 4))); }
+        void patch(size_t at, size_t target)
+        {
+            uint32_t rel = static_cast<uint32_t>(target - at);
+            memcpy(&code[at - 4], &rel, 4);
+        }
+        void ret() { byte(0xC3); }
+    };
+
+    constexpr int EAX = 0, ECX = 1, EDX = 2;
+    constexpr int REG_I = 16; // V0-VF are 0-15 in blockRegs
+    constexpr int PIN_REGISTERS[] = { 9, 10, 11, 12, 13, 14, 15 }; // r9-r11 are free to clobber, r12-r15 are saved around the block
+
+    // Where a block keeps each CHIP-8 register: a host register for the ones used more than once, the
+    // Chip8 otherwise. Pinned values stay zero-extended, they are loaded on entry and stored on exit.
+    struct blockRegs
+    {
+        int8_t host[17];
+        uint16_t uses[17];
+        blockRegs() { memset(host, -1, sizeof(host)); memset(uses, 0, sizeof(uses)); }
+    };
+
+    // Operand helpers: the same CHIP-8 access either way round, counting uses for the pinning pass
+    struct operands
+    {
+        emitter& e;
+        const chip8Offsets& o;
+        blockRegs& regs;
+
+        int pin(int v) { ++regs.uses[v]; return regs.host[v]; }
+        void load(int r, int v) { int h = pin(v); if (h >= 0) e.movzxRegReg8(r, h); else e.movzxRegMem8(r, o.V + v); }
+        void store(int v, int r) { int h = pin(v); if (h >= 0) e.movzxRegReg8(h, r); else e.movMemReg8(o.V + v, r); }
+        void set(int v, uint8_t nn) { int h = pin(v); if (h >= 0) e.movRegImm(h, nn); else e.movMemImm8(o.V + v, nn); }
+        void add(int v, uint8_t nn) { int h = pin(v); if (h >= 0) e.addRegImm8(h, nn); else e.addMemImm8(o.V + v, nn); }
+        void compare(int v, uint8_t nn) { int h = pin(v); if (h >= 0) e.cmpRegImm8(h, nn); else e.cmpMemImm8(o.V + v, nn); }
+        void setI(uint16_t nnn) { int h = pin(REG_I); if (h >= 0) e.movRegImm(h, nnn); else e.movMemImm16(o.I, nnn); }
+        void addI(int r) { int h = pin(REG_I); if (h >= 0) e.addRegReg16(h, r); else e.addMemReg16(o.I, r); }
+    };
+
+    enum jitOp { JIT_UNSUPPORTED, JIT_STRAIGHT, JIT_TERMINATOR };
+
+    // Emit one instruction. Skips and 1nnn only compute the next pc into ax and report JIT_TERMINATOR.
+    jitOp translate(operands& op, const instruction_t& in, uint16_t address, const Quirks& quirks)
+    {
+        emitter& e = op.e;
+        OpcodeHandler handler = Opcodes::decode(in.opcode);
+        uint16_t next = address + 2;
+        uint16_t skip = address + 4;
+
+        if (handler == &Opcodes::handle6) { op.set(in.x, in.nn); return JIT_STRAIGHT; }
+        if (handler == &Opcodes::handle7) { op.add(in.x, in.nn); return JIT_STRAIGHT; }
+        if (handler == &Opcodes::handleA) { op.setI(in.nnn); return JIT_STRAIGHT; }
+        if (handler == &Opcodes::handle8xy0) { op.load(EAX, in.y); op.store(in.x, EAX); return JIT_STRAIGHT; }
+        if (handler == &Opcodes::handle8xy1 || handler == &Opcodes::handle8xy2 || handler == &Opcodes::handle8xy3)
+        {
+            uint8_t alu = handler == &Opcodes::handle8xy1 ? 0x08 : handler == &Opcodes::handle8xy2 ? 0x20 : 0x30;
+            op.load(EAX, in.x);
+            op.load(ECX, in.y);
+            e.aluAlCl(alu);
+            op.store(in.x, EAX);
+            if (quirks.vfReset)
+                op.set(0xF, 0);
+            return JIT_STRAIGHT;
+        }
+        if (handler == &Opcodes::handle8xy4 || handler == &Opcodes::handle8xy5)
+        {
+            op.load(EAX, in.x);
+            op.load(ECX, in.y);
+            if (handler == &Opcodes::handle8xy4) { e.aluAlCl(0x00); e.setcDl(); }
+            else { e.aluAlCl(0x28); e.setncDl(); }
+            op.store(in.x, EAX);
+            op.store(0xF, EDX); // VF last so it wins when x is F, like the interpreter
+            return JIT_STRAIGHT;
+        }
+        if (handler == &Opcodes::handle8xy7)
+        {
+            op.load(EAX, in.y);
+            op.load(ECX, in.x);
+            e.aluAlCl(0x28);
+            e.setncDl();
+            op.store(in.x, EAX);
+            op.store(0xF, EDX);
+            return JIT_STRAIGHT;
+        }
+        if (handler == &Opcodes::handle8xy6 || handler == &Opcodes::handle8xyE)
+        {
+            op.load(EAX, quirks.shifting ? in.x : in.y);
+            if (handler == &Opcodes::handle8xy6) e.shrAl(); else e.shlAl();
+            e.setcDl();
+            op.store(in.x, EAX);
+            op.store(0xF, EDX);
+            return JIT_STRAIGHT;
+        }
+        if (handler == &Opcodes::handleFx07) { e.movzxRegMem8(EAX, op.o.delayTimer); op.store(in.x, EAX); return JIT_STRAIGHT; }
+        if (handler == &Opcodes::handleFx15) { op.load(EAX, in.x); e.movMemReg8(op.o.delayTimer, EAX); return JIT_STRAIGHT; }
+        if (handler == &Opcodes::handleFx18) { op.load(EAX, in.x); e.movMemReg8(op.o.soundTimer, EAX); return JIT_STRAIGHT; }
+        if (handler == &Opcodes::handleFx1E) { op.load(EAX, in.x); op.addI(EAX); return JIT_STRAIGHT; }
+
+        if (handler == &Opcodes::handle1)
+        {
+            e.movRegImm(EAX, in.nnn);
+            return JIT_TERMINATOR;
+        }
+        // mov leaves the flags alone, so the next and skip targets load between the compare and the cmov
+        if (handler == &Opcodes::handle3 || handler == &Opcodes::handle4)
+        {
+            op.compare(in.x, in.nn);
+            e.movRegImm(EAX, next);
+            e.movRegImm(ECX, skip);
+            if (handler == &Opcodes::handle3) e.cmoveEaxEcx(); else e.cmovneEaxEcx();
+            return JIT_TERMINATOR;
+        }
+        if (handler == &Opcodes::handle5 || handler == &Opcodes::handle9)
+        {
+            op.load(EDX, in.x);
+            op.load(ECX, in.y);
+            e.cmpDlCl();
+            e.movRegImm(EAX, next);
+            e.movRegImm(ECX, skip);
+            if (handler == &Opcodes::handle5) e.cmoveEaxEcx(); else e.cmovneEaxEcx();
+            return JIT_TERMINATOR;
+        }
+        if (handler == &Opcodes::handleEx9E || handler == &Opcodes::handleExA1)
+        {
+            op.load(EDX, in.x);
+            e.andEdxImm8(0x0F); // Keep the index inside the 16 keys, like the interpreters
+            e.movRegImm(EAX, next);
+            e.movRegImm(ECX, skip);
+            e.cmpKeypadRdx(op.o.keypad);
+            if (handler == &Opcodes::handleEx9E) e.cmovneEaxEcx(); else e.cmoveEaxEcx();
+            return JIT_TERMINATOR;
+        }
+        return JIT_UNSUPPORTED;
+    }
+}
+
+Chip8Jit::Chip8Jit()
+{
+    memset(covered, 0, sizeof(covered));
+    memset(written, 0, sizeof(written));
+#ifdef SDL_C8_JIT
+    void* buffer = mmap(nullptr, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    codeBuffer = buffer == MAP_FAILED ? nullptr : static_cast<uint8_t*>(buffer);
+#endif
+}
+
+Chip8Jit::~Chip8Jit()
+{
+#ifdef SDL_C8_JIT
+    if (codeBuffer)
+    {
+        munmap(codeBuffer, CODE_BUFFER_SIZE);
+    }
+#endif
+}
+
+bool Chip8Jit::available()
+{
+#ifdef SDL_C8_JIT
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint32_t Chip8Jit::run(Chip8 &chip8, uint32_t count)
+{
+    uint32_t executed = 0;
+    while (executed < count && chip8.state != Chip8::STOPPED)
+    {
+        uint32_t remaining = count - executed;
+        if (chip8.pc <= 0xFFE && codeBuffer)
+        {
+            jitBlock &block = blocks[chip8.pc];
+            if (!block.compiled)
+            {
+                compile(chip8, chip8.pc);
+            }
+            if (block.code && block.length <= remaining)
+            {
+                executed += block.code(&chip8, remaining);
+                continue;
+            }
+        }
+        // Untranslated opcode, or not enough budget left for the whole block
+        chip8.emulateInstruction();
+        ++executed;
+    }
+    return executed;
+}
+
+void Chip8Jit::invalidate(uint16_t address, uint16_t length)
+{
+    for (int i = 0; i < length; ++i)
+    {
+        int byte = (address + i) & 0xFFF;
+        if (!covered[byte])
+        {
+            continue;
+        }
+        written[byte] = true;
+        // Only blocks starting at most one block length back can reach this byte, drop those that do
+        for (int start = std::max(0, byte - 2 * MAX_BLOCK_LENGTH + 1); start <= byte; ++start)
+        {
+            if (blocks[start].code && blocks[start].end > byte)
+            {
+                blocks[start] = jitBlock(); // Its code stays in the buffer until the next flush
+            }
+        }
+    }
+}
+
+void Chip8Jit::flush()
+{
+    for (jitBlock &block : blocks)
+    {
+        block = jitBlock();
+    }
+    memset(covered, 0, sizeof(covered));
+    codeUsed = 0;
+}
+
+void Chip8Jit::compile(Chip8 &chip8, uint16_t start)
+{
+#ifdef SDL_C8_JIT
+    chip8Offsets offsets = offsetsOf(chip8);
+    blockRegs regs;
+
+    // First pass finds the block's extent and how often it uses each register
+    emitter scan;
+    operands counting{ scan, offsets, regs };
+    uint16_t address = start;
+    int length = 0;
+    bool terminated = false;
+    bool selfLoop = false;
+    while (length < MAX_BLOCK_LENGTH && address <= 0xFFE && !written[address] && !written[address + 1])
+    {
+        instruction_t in(chip8.memory[address] << 8 | chip8.memory[address + 1]);
+        jitOp op = translate(counting, in, address, chip8.quirks);
+        if (op == JIT_UNSUPPORTED)
+        {
+            break;
+        }
+        ++length;
+        address += 2;
+        if (op == JIT_TERMINATOR)
+        {
+            terminated = true;
+            selfLoop = Opcodes::decode(in.opcode) == &Opcodes::handle1 && in.nnn == start;
+            break;
+        }
+    }
+
+    jitBlock &block = blocks[start];
+    block.compiled = true;
+    if (length == 0)
+    {
+        return; // Leave it to the interpreter
+    }
+
+    // Pin the busiest registers. One use does not pay for the load and store, unless the block loops on itself.
+    int pinned[sizeof(PIN_REGISTERS) / sizeof(PIN_REGISTERS[0])];
+    int pinCount = 0;
+    for (int &host : pinned)
+    {
+        int best = -1;
+        for (int v = 0; v <= REG_I; ++v)
+        {
+            if (regs.host[v] < 0 && regs.uses[v] > (selfLoop ? 0 : 1) && (best < 0 || regs.uses[v] > regs.uses[best]))
+                best = v;
+        }
+        if (best < 0)
+            break;
+        host = best;
+        regs.host[best] = static_cast<int8_t>(PIN_REGISTERS[pinCount++]);
+    }
+
+    emitter e;
+    operands emit{ e, offsets, regs };
+    for (int i = 0; i < pinCount; ++i)
+    {
+        if (PIN_REGISTERS[i] >= 12)
+            e.push(PIN_REGISTERS[i]);
+    }
+    e.xorR8d();
+    for (int i = 0; i < pinCount; ++i)
+    {
+        if (pinned[i] == REG_I) e.movzxRegMem16(PIN_REGISTERS[i], offsets.I);
+        else e.movzxRegMem8(PIN_REGISTERS[i], offsets.V + pinned[i]);
+    }
+    size_t top = e.code.size();
+    for (uint16_t at = start; at < address; at += 2)
+    {
+        translate(emit, instruction_t(chip8.memory[at] << 8 | chip8.memory[at + 1]), at, chip8.quirks);
+    }
+    if (!terminated)
+    {
+        e.movRegImm(EAX, address); // Fell off the end, continue at the first untranslated opcode
+    }
+    e.movMemReg16(offsets.pc, EAX);
+    e.addR8dImm(length);
+    if (selfLoop)
+    {
+        // Jump to self: keep looping in native code while the budget covers another pass
+        e.leaEaxR8Imm(length);
+        e.cmpEaxEsi();
+        size_t exit = e.jaRel32();
+        e.jmpTo(top);
+        e.patch(exit, e.code.size());
+    }
+    for (int i = 0; i < pinCount; ++i)
+    {
+        if (pinned[i] == REG_I) e.movMemReg16(offsets.I, PIN_REGISTERS[i]);
+        else e.movMemReg8(offsets.V + pinned[i], PIN_REGISTERS[i]);
+    }
+    for (int i = pinCount - 1; i >= 0; --i)
+    {
+        if (PIN_REGISTERS[i] >= 12)
+            e.pop(PIN_REGISTERS[i]);
+    }
+    e.movEaxR8d();
+    e.ret();
+
+    if (e.code.size() > MAX_BLOCK_BYTES || codeUsed + e.code.size() > CODE_BUFFER_SIZE)
+    {
+        flush();
+        blocks[start].compiled = true;
+        if (e.code.size() > MAX_BLOCK_BYTES)
+        {
+            return;
+        }
+    }
+    mprotect(codeBuffer, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE);
+    memcpy(codeBuffer + codeUsed, e.code.data(), e.code.size());
+    mprotect(codeBuffer, CODE_BUFFER_SIZE, PROT_READ | PROT_EXEC);
+    blocks[start].code = reinterpret_cast<blockFn>(codeBuffer + codeUsed);
+    blocks[start].length = length;
+    blocks[start].end = address;
+    codeUsed += e.code.size();
+    for (uint16_t byte = start; byte < address; ++byte)
+    {
+        covered[byte] = true;
+    }
+#else
+    (void)chip8;
+    blocks[start].compiled = true;
+#endif
+}
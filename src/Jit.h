@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+class Chip8; //Using forward declaration to avoid circular dependency
+
+// Basic-block recompiler from CHIP-8 to x86-64. A block starts at pc and runs straight-line
+// register/ALU opcodes up to and including a terminator (1nnn or a skip). Opcodes it does not
+// translate (Dxyn, Fx0A, 2nnn, 00EE, Bnnn, memory stores...) end the block and are executed by
+// Chip8::emulateInstruction. The V registers and I a block uses more than once live in host
+// registers from its entry to its exit. A ROM write drops just the blocks covering the written
+// bytes, and those bytes are never compiled again. Quirks are baked in at compile time, Chip8
+// resets the JIT whenever they change. Only the 4KB platforms are compiled, XO-CHIP programs run
+// on the threaded interpreter.
+class Chip8Jit
+{
+    public:
+        Chip8Jit();
+        ~Chip8Jit();
+        Chip8Jit(const Chip8Jit&) = delete;
+        Chip8Jit& operator=(const Chip8Jit&) = delete;
+
+        static bool available(); // False on hosts without x86-64 and mmap, callers fall back to the interpreter
+        uint32_t run(Chip8& chip8, uint32_t count); // Same contract as Chip8::run
+        void invalidate(uint16_t address, uint16_t length); // The ROM wrote these bytes
+
+    private:
+        using blockFn = uint32_t (*)(Chip8* chip8, uint32_t budget); // Returns instructions executed
+
+        struct jitBlock
+        {
+            blockFn code = nullptr; // nullptr means interpret the instruction at this pc
+            uint16_t length = 0; // Instructions per pass through the block
+            uint16_t end = 0; // One past the block's last byte
+            bool compiled = false;
+        };
+
+        void compile(Chip8& chip8, uint16_t start);
+        void flush();
+
+        jitBlock blocks[4096];
+        bool covered[4096]; // Bytes some block compiled since the last flush belongs to, writes elsewhere need no lookup
+        bool written[4096]; // Compiled bytes the ROM has modified, left to the interpreter from then on
+        uint8_t* codeBuffer = nullptr;
+        size_t codeUsed = 0;
+};
@@ -0,0 +1,127 @@
+#include "Movie.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+void Movie::start(const Chip8 &chip8, uint32_t instructionsPerFrame)
+{
+    header = movieHeader();
+    header.instructionsPerFrame = instructionsPerFrame;
+    header.seed = chip8.rngState;
+    header.quirks = chip8.quirks.bits();
+    header.romHash = chip8.romHash;
+    events.clear();
+    hashes.clear();
+}
+
+void Movie::record(const Chip8 &chip8)
+{
+    uint16_t keys = keypadMask(chip8);
+    if (events.empty() ? keys != 0 : keys != events.back().keys)
+    {
+        events.push_back({ header.frames, 0, keys, 0 });
+    }
+    hashes.push_back(chip8.stateHash());
+    ++header.frames;
+}
+
+void Movie::keyChange(const Chip8 &chip8, uint32_t instruction)
+{
+    events.push_back({ header.frames, instruction, keypadMask(chip8), 0 });
+}
+
+void Movie::truncate(uint32_t frames)
+{
+    if (frames >= header.frames)
+        return;
+    while (!events.empty() && events.back().frame >= frames)
+    {
+        events.pop_back();
+    }
+    hashes.resize(frames);
+    header.frames = frames;
+}
+
+bool Movie::save(const std::string &path) const
+{
+    movieHeader out = header;
+    out.events = static_cast<uint32_t>(events.size());
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&out), sizeof(out));
+    file.write(reinterpret_cast<const char*>(events.data()), events.size() * sizeof(movieEvent));
+    file.write(reinterpret_cast<const char*>(hashes.data()), hashes.size() * sizeof(uint64_t));
+    return static_cast<bool>(file);
+}
+
+bool Movie::load(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || header.magic != movieHeader::MAGIC || header.version != movieHeader::VERSION)
+    {
+        return false;
+    }
+    events.resize(header.events);
+    hashes.resize(header.frames);
+    file.read(reinterpret_cast<char*>(events.data()), events.size() * sizeof(movieEvent));
+    file.read(reinterpret_cast<char*>(hashes.data()), hashes.size() * sizeof(uint64_t));
+    return static_cast<bool>(file);
+}
+
+replayResult Movie::replay(Chip8 &chip8) const
+{
+    replayResult result;
+    if (chip8.romHash != header.romHash || header.instructionsPerFrame == 0)
+    {
+        return result;
+    }
+    result.ok = true;
+    chip8.seedRandom(header.seed);
+    chip8.quirks = Quirks::fromBits(header.quirks);
+    applyKeypad(chip8, 0);
+    auto start = std::chrono::steady_clock::now();
+    size_t nextEvent = 0;
+    for (uint32_t frame = 0; frame < header.frames && chip8.state != Chip8::STOPPED; ++frame)
+    {
+        uint32_t executed = 0;
+        while (nextEvent < events.size() && events[nextEvent].frame <= frame)
+        {
+            const movieEvent &event = events[nextEvent++];
+            if (event.frame == frame && event.instruction > executed)
+            {
+                executed += chip8.run(std::min<uint32_t>(event.instruction, header.instructionsPerFrame) - executed);
+            }
+            applyKeypad(chip8, event.keys);
+        }
+        if (executed < header.instructionsPerFrame)
+        {
+            chip8.run(header.instructionsPerFrame - executed);
+        }
+        chip8.updateTimers();
+        ++result.frames;
+        if (result.firstDivergence < 0 && chip8.stateHash() != hashes[frame])
+        {
+            result.firstDivergence = frame;
+        }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+uint16_t Movie::keypadMask(const Chip8 &chip8)
+{
+    uint16_t keys = 0;
+    for (int key = 0; key < 16; ++key)
+    {
+        keys |= static_cast<uint16_t>(chip8.keypad[key]) << key;
+    }
+    return keys;
+}
+
+void Movie::applyKeypad(Chip8 &chip8, uint16_t keys)
+{
+    for (int key = 0; key < 16; ++key)
+    {
+        chip8.keypad[key] = (keys >> key) & 1;
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Chip8.h"
+
+struct movieHeader
+{
+    static constexpr uint32_t MAGIC = 0x4D384843; // "CH8M"
+    static constexpr uint16_t VERSION = 6; // 2: quirks hold all five Quirks::bits, 3: state hashes cover XO-CHIP audio, 4: XO-CHIP bit, 64KB memory and planes, 5: half scroll bit, 6: 32-bit instruction counts
+    uint32_t magic = MAGIC;
+    uint16_t version = VERSION;
+    uint16_t reserved = 0;
+    uint32_t instructionsPerFrame = 0;
+    uint32_t seed = 0; // rngState when recording started
+    uint32_t quirks = 0; // Quirks::bits
+    uint32_t frames = 0;
+    uint32_t events = 0;
+    uint64_t romHash = 0; // Chip8::romHash of the recorded ROM
+};
+static_assert(sizeof(movieHeader) == 40, "movieHeader is written to disk as is");
+
+struct movieEvent
+{
+    uint32_t frame; // First frame the keypad has this state
+    uint32_t instruction; // Instructions into the frame the change lands at
+    uint16_t keys; // Bit k set while key k is down
+    uint16_t reserved;
+};
+static_assert(sizeof(movieEvent) == 12, "movieEvent is written to disk as is");
+
+struct replayResult
+{
+    bool ok = false; // False when the movie does not belong to this ROM
+    uint64_t frames = 0; // Frames replayed
+    int64_t firstDivergence = -1; // First frame whose state hash differs from the recording, -1 if none
+    double seconds = 0;
+};
+
+// Input recording: the RNG seed, timing and quirks a run started with, every keypad change keyed
+// by frame, and the state hash after each frame. Replaying feeds the same input to a headless
+// Chip8 as fast as it will go and reports the first frame that no longer matches.
+class Movie
+{
+    public:
+        void start(const Chip8& chip8, uint32_t instructionsPerFrame); // Call before the first frame runs
+        void record(const Chip8& chip8); // Call once at the end of every frame
+        void keyChange(const Chip8& chip8, uint32_t instruction); // Keypad changed partway through the current frame
+        void truncate(uint32_t frames); // Forget everything after the first frames, used when rewinding
+        bool save(const std::string& path) const;
+        bool load(const std::string& path);
+        replayResult replay(Chip8& chip8) const; // chip8 must be freshly loaded with the recorded ROM
+
+        static uint16_t keypadMask(const Chip8& chip8);
+        static void applyKeypad(Chip8& chip8, uint16_t keys);
+
+        movieHeader header;
+        std::vector<movieEvent> events;
+        std::vector<uint64_t> hashes; // One per frame
+};
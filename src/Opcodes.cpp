@@ -1,34 +1,103 @@
-#include <iostream>
+#include <array>
+#include <utility>
 #include "Configuration.h"
 #include "Opcodes.h"
 #include "Chip8.h"
 
 void Opcodes::handle0(Chip8 &chip8)
 {
+    if ((chip8.nn() & 0xF0) == 0xC0)
+    {
+        handle00Cn(chip8);
+        return;
+    }
+    if (chip8.quirks.xoChip && (chip8.nn() & 0xF0) == 0xD0)
+    {
+        handle00Dn(chip8);
+        return;
+    }
     switch (chip8.nn()) // 0x00nn (grab the 3rd and 4th nibble of the opcode)
     {
         case 0x00E0: // Clear the display
-            memset(chip8.display, false, sizeof(chip8.display));
+            handle00E0(chip8);
             break;
         case 0x00EE: // Return from subroutine
-        {
-            uint16_t returnAddress = chip8.stack.back();
-            chip8.stack.pop_back();
-            chip8.pc = returnAddress; // Set PC to the address popped from the stack
+            handle00EE(chip8);
+            break;
+        case 0x00FB: // Scroll right
+            handle00FB(chip8);
+            break;
+        case 0x00FC: // Scroll left
+            handle00FC(chip8);
             break;
-        }
         case 0x00FD: // Quit the emulator
-            chip8.state = Chip8::STOPPED; // Set state to STOPPED
+            handle00FD(chip8);
             break;
         case 0x00FF: // High-resolution display mode
-            chip8.highResDisplay = true; // Set high-resolution display mode
+            handle00FF(chip8);
             break;
         case 0x00FE: // Regular display mode
-            chip8.highResDisplay = false; // Set regular display mode
+            handle00FE(chip8);
             break;
         default:
-            std::cerr << "Unknown opcode: " << chip8.opcode() << std::endl;
+            chip8.raiseTrap(TRAP_UNKNOWN_OPCODE);
+    }
+}
+
+void Opcodes::handle00E0(Chip8 &chip8)
+{
+    for (int plane = 0; plane < DISPLAY_PLANES; ++plane)
+    {
+        if (chip8.planeMask & (1 << plane))
+            memset(chip8.display[plane], 0, sizeof(chip8.display[plane])); // Only the selected planes
+    }
+    chip8.dirtyRows = ~0ull;
+}
+
+void Opcodes::handle00Cn(Chip8 &chip8)
+{
+    chip8.scrollVertical(chip8.n()); // Scroll down n pixels
+}
+
+void Opcodes::handle00Dn(Chip8 &chip8)
+{
+    chip8.scrollVertical(-chip8.n()); // XO-CHIP scroll up n pixels
+}
+
+void Opcodes::handle00FB(Chip8 &chip8)
+{
+    chip8.scrollHorizontal(4);
+}
+
+void Opcodes::handle00FC(Chip8 &chip8)
+{
+    chip8.scrollHorizontal(-4);
+}
+
+void Opcodes::handle00EE(Chip8 &chip8)
+{
+    if (chip8.sp == 0)
+    {
+        chip8.raiseTrap(TRAP_STACK_UNDERFLOW);
+        chip8.state = Chip8::STOPPED;
+        return;
     }
+    chip8.pc = chip8.stack[--chip8.sp]; // Set PC to the address popped from the stack
+}
+
+void Opcodes::handle00FD(Chip8 &chip8)
+{
+    chip8.state = Chip8::STOPPED; // Set state to STOPPED
+}
+
+void Opcodes::handle00FF(Chip8 &chip8)
+{
+    chip8.highResDisplay = true; // Set high-resolution display mode
+}
+
+void Opcodes::handle00FE(Chip8 &chip8)
+{
+    chip8.highResDisplay = false; // Set regular display mode
 }
 
 void Opcodes::handle1(Chip8 &chip8)
@@ -38,7 +107,13 @@ void Opcodes::handle1(Chip8 &chip8)
 
 void Opcodes::handle2(Chip8 &chip8)
 {
-    chip8.stack.push_back(chip8.pc);
+    if (chip8.sp == sizeof(chip8.stack) / sizeof(chip8.stack[0]))
+    {
+        chip8.raiseTrap(TRAP_STACK_OVERFLOW);
+        chip8.state = Chip8::STOPPED;
+        return;
+    }
+    chip8.stack[chip8.sp++] = chip8.pc;
     chip8.pc = chip8.nnn();
 }
 
@@ -46,7 +121,7 @@ void Opcodes::handle3(Chip8 &chip8)
 {
     if (chip8.V[chip8.x()] == chip8.nn()) // Skip next instruction if Vx == nn
     {
-        chip8.pc += 2; //Incrementing PC by 2 skips the next instruction
+        chip8.skipNext();
     }
 }
 
@@ -54,15 +129,50 @@ void Opcodes::handle4(Chip8 &chip8)
 {
     if (chip8.V[chip8.x()] != chip8.nn()) // Skip next instruction if Vx != nn
     {
-        chip8.pc += 2;
+        chip8.skipNext();
     }
 }
 
 void Opcodes::handle5(Chip8 &chip8)
 {
+    if (chip8.quirks.xoChip && chip8.n() == 0x2)
+    {
+        handle5xy2(chip8);
+        return;
+    }
+    if (chip8.quirks.xoChip && chip8.n() == 0x3)
+    {
+        handle5xy3(chip8);
+        return;
+    }
     if (chip8.V[chip8.x()] == chip8.V[chip8.y()]) // Skip next instruction if Vx == Vy
     {
-        chip8.pc += 2;
+        chip8.skipNext();
+    }
+}
+
+void Opcodes::handle5xy2(Chip8 &chip8)
+{
+    // Store Vx to Vy at I, counting down when x > y, I is left as it was
+    int step = chip8.x() <= chip8.y() ? 1 : -1;
+    int count = (chip8.y() - chip8.x()) * step + 1;
+    chip8.checkRange(chip8.I, count);
+    for (int i = 0; i < count; ++i)
+    {
+        chip8.memory[(chip8.I + i) & chip8.addressMask] = chip8.V[chip8.x() + i * step];
+    }
+    chip8.invalidateDecodeCache(chip8.I, count);
+}
+
+void Opcodes::handle5xy3(Chip8 &chip8)
+{
+    // Load Vx to Vy from I
+    int step = chip8.x() <= chip8.y() ? 1 : -1;
+    int count = (chip8.y() - chip8.x()) * step + 1;
+    chip8.checkRange(chip8.I, count);
+    for (int i = 0; i < count; ++i)
+    {
+        chip8.V[chip8.x() + i * step] = chip8.memory[(chip8.I + i) & chip8.addressMask];
     }
 }
 
@@ -80,77 +190,95 @@ void Opcodes::handle8(Chip8 &chip8)
 {
     switch (chip8.n()) //8xyn (grab the fourth nibble (n) from the opcode)
     {
-        case 0x0:
-            // Load Vx with Vy
-            chip8.V[chip8.x()] = chip8.V[chip8.y()];
-            break;
-        case 0x1:
-            // Set Vx to Vx OR Vy
-            chip8.V[chip8.x()] |= chip8.V[chip8.y()];
-            if (configuration::vfReset)
-                chip8.V[0xF] = 0; // QUIRK - configure with vfReset
-            break;
-        case 0x2:
-            // Set Vx to Vx AND Vy
-            chip8.V[chip8.x()] &= chip8.V[chip8.y()];
-            if (configuration::vfReset)
-                chip8.V[0xF] = 0; // QUIRK - configure with vfReset
-            break;
-        case 0x3:
-            // Set Vx to Vx XOR Vy
-            chip8.V[chip8.x()] ^= chip8.V[chip8.y()];
-            if (configuration::vfReset)
-                chip8.V[0xF] = 0; // QUIRK - configure with vfReset
-            break;
-        case 0x4:
-        {
-            bool carry = (chip8.V[chip8.x()] + chip8.V[chip8.y()]) > 0xFF; // Check for overflow
-            chip8.V[chip8.x()] += chip8.V[chip8.y()];
-            chip8.V[0xF] = carry; // Set VF to 1 if there's a carry, 0 otherwise
-            break;
-        }
-        case 0x5:
-        {
-            bool carry = chip8.V[chip8.x()] >= chip8.V[chip8.y()];
-            chip8.V[chip8.x()] -= chip8.V[chip8.y()];
-            chip8.V[0xF] = carry;
-            break;
-        }
-        case 0x6:
-        {
-            chip8.V[chip8.x()] = chip8.V[chip8.y()]; //Quirk - configure with chip mode
-            int shiftedBit = chip8.V[chip8.x()] & 0x1; //Get the least significant bit
-            chip8.V[chip8.x()] >>= 1;
-            chip8.V[0xF] = shiftedBit; // Set VF to the least significant bit before shifting
-            break;
-        }
-        case 0x7:
-        {
-            bool carry = chip8.V[chip8.y()] >= chip8.V[chip8.x()];
-            chip8.V[chip8.x()] = chip8.V[chip8.y()] - chip8.V[chip8.x()];
-            chip8.V[0xF] = carry;
-            break;
-        }
-        case 0xE:
-        {
-            chip8.V[chip8.x()] = chip8.V[chip8.y()]; //Quirk - configure with chip mode
-            int shiftedBit = (chip8.V[chip8.x()] & 0x80) >> 7; // Get the most significant bit before shifting
-            chip8.V[chip8.x()] <<= 1;
-            chip8.V[0xF] = shiftedBit; // Set VF to the most significant bit before shifting
-            break;
-        }
+        case 0x0: handle8xy0(chip8); break;
+        case 0x1: handle8xy1(chip8); break;
+        case 0x2: handle8xy2(chip8); break;
+        case 0x3: handle8xy3(chip8); break;
+        case 0x4: handle8xy4(chip8); break;
+        case 0x5: handle8xy5(chip8); break;
+        case 0x6: handle8xy6(chip8); break;
+        case 0x7: handle8xy7(chip8); break;
+        case 0xE: handle8xyE(chip8); break;
         default:
-            //Handle unknown opcodes
-            std::cerr << "Unknown opcode: " << std::hex << chip8.opcode() << std::dec << std::endl;
+            chip8.raiseTrap(TRAP_UNKNOWN_OPCODE);
             break;
     }
 }
 
+void Opcodes::handle8xy0(Chip8 &chip8)
+{
+    // Load Vx with Vy
+    chip8.V[chip8.x()] = chip8.V[chip8.y()];
+}
+
+void Opcodes::handle8xy1(Chip8 &chip8)
+{
+    // Set Vx to Vx OR Vy
+    chip8.V[chip8.x()] |= chip8.V[chip8.y()];
+    if (chip8.quirks.vfReset)
+        chip8.V[0xF] = 0; // QUIRK - configure with vfReset
+}
+
+void Opcodes::handle8xy2(Chip8 &chip8)
+{
+    // Set Vx to Vx AND Vy
+    chip8.V[chip8.x()] &= chip8.V[chip8.y()];
+    if (chip8.quirks.vfReset)
+        chip8.V[0xF] = 0; // QUIRK - configure with vfReset
+}
+
+void Opcodes::handle8xy3(Chip8 &chip8)
+{
+    // Set Vx to Vx XOR Vy
+    chip8.V[chip8.x()] ^= chip8.V[chip8.y()];
+    if (chip8.quirks.vfReset)
+        chip8.V[0xF] = 0; // QUIRK - configure with vfReset
+}
+
+void Opcodes::handle8xy4(Chip8 &chip8)
+{
+    bool carry = (chip8.V[chip8.x()] + chip8.V[chip8.y()]) > 0xFF; // Check for overflow
+    chip8.V[chip8.x()] += chip8.V[chip8.y()];
+    chip8.V[0xF] = carry; // Set VF to 1 if there's a carry, 0 otherwise
+}
+
+void Opcodes::handle8xy5(Chip8 &chip8)
+{
+    bool carry = chip8.V[chip8.x()] >= chip8.V[chip8.y()];
+    chip8.V[chip8.x()] -= chip8.V[chip8.y()];
+    chip8.V[0xF] = carry;
+}
+
+void Opcodes::handle8xy6(Chip8 &chip8)
+{
+    if (!chip8.quirks.shifting)
+        chip8.V[chip8.x()] = chip8.V[chip8.y()]; // QUIRK - configure with shifting
+    int shiftedBit = chip8.V[chip8.x()] & 0x1; //Get the least significant bit
+    chip8.V[chip8.x()] >>= 1;
+    chip8.V[0xF] = shiftedBit; // Set VF to the least significant bit before shifting
+}
+
+void Opcodes::handle8xy7(Chip8 &chip8)
+{
+    bool carry = chip8.V[chip8.y()] >= chip8.V[chip8.x()];
+    chip8.V[chip8.x()] = chip8.V[chip8.y()] - chip8.V[chip8.x()];
+    chip8.V[0xF] = carry;
+}
+
+void Opcodes::handle8xyE(Chip8 &chip8)
+{
+    if (!chip8.quirks.shifting)
+        chip8.V[chip8.x()] = chip8.V[chip8.y()]; // QUIRK - configure with shifting
+    int shiftedBit = (chip8.V[chip8.x()] & 0x80) >> 7; // Get the most significant bit before shifting
+    chip8.V[chip8.x()] <<= 1;
+    chip8.V[0xF] = shiftedBit; // Set VF to the most significant bit before shifting
+}
+
 void Opcodes::handle9(Chip8 &chip8)
 {
     if (chip8.V[chip8.x()] != chip8.V[chip8.y()]) // Skip next instruction if Vx != Vy
     {
-        chip8.pc += 2;
+        chip8.skipNext();
     }
 }
 
@@ -161,7 +289,7 @@ void Opcodes::handleA(Chip8 &chip8)
 
 void Opcodes::handleB(Chip8 &chip8)
 {
-    if (!configuration::jumping)
+    if (!chip8.quirks.jumping)
         chip8.pc = chip8.nnn() + chip8.V[0]; // QUIRK - configure with Jumping - 0 if off, X if on
     else
         chip8.pc = chip8.nnn() + chip8.V[chip8.x()]; // QUIRK - configure with Jumping - 0 if off, X if on
@@ -169,113 +297,409 @@ void Opcodes::handleB(Chip8 &chip8)
 
 void Opcodes::handleC(Chip8 &chip8)
 {
-    chip8.V[chip8.x()] = (rand() % 256) & chip8.nn(); // Set Vx to a random number
+    chip8.V[chip8.x()] = chip8.nextRandom() & chip8.nn(); // Set Vx to a random number
 }
 
 void Opcodes::handleD(Chip8 &chip8)
 {
-    chip8.updatec8display();
+    if (chip8.quirks.clipping)
+        chip8.updatec8display(); // QUIRK - configure with clipping
+    else
+        chip8.updatec8displayWrapping();
 }
 
 void Opcodes::handleE(Chip8 &chip8)
 {
     switch (chip8.nn()) // 0xExnn (grab the last byte of the opcode)
     {
-        case 0x9E:
-            if (chip8.keypad[chip8.V[chip8.x()]]) // Skip next instruction if key Vx is pressed
-            {
-                chip8.pc += 2;
-            }
-            break;
-        case 0xA1:
-            if (!chip8.keypad[chip8.V[chip8.x()]]) // Skip next instruction if key Vx is not pressed
-            {
-                chip8.pc += 2;
-            }
-            break;
+        case 0x9E: handleEx9E(chip8); break;
+        case 0xA1: handleExA1(chip8); break;
         default:
-            std::cerr << "Unknown opcode: " << chip8.opcode() << std::endl;
+            chip8.raiseTrap(TRAP_UNKNOWN_OPCODE);
             break;
     }
 }
 
+void Opcodes::handleEx9E(Chip8 &chip8)
+{
+    if (chip8.keypad[chip8.V[chip8.x()] & 0xF]) // Skip next instruction if key Vx is pressed, only its low nibble names a key
+    {
+        chip8.skipNext();
+    }
+}
+
+void Opcodes::handleExA1(Chip8 &chip8)
+{
+    if (!chip8.keypad[chip8.V[chip8.x()] & 0xF]) // Skip next instruction if key Vx is not pressed
+    {
+        chip8.skipNext();
+    }
+}
+
 void Opcodes::handleF(Chip8 &chip8)
 {
+    if (chip8.quirks.xoChip && chip8.opcode() == 0xF000)
+    {
+        handleF000(chip8);
+        return;
+    }
+    if (chip8.quirks.xoChip && chip8.nn() == 0x01)
+    {
+        handleFn01(chip8);
+        return;
+    }
+    if (chip8.quirks.xoChip && chip8.opcode() == 0xF002)
+    {
+        handleF002(chip8);
+        return;
+    }
+    if (chip8.quirks.xoChip && chip8.nn() == 0x3A)
+    {
+        handleFx3A(chip8);
+        return;
+    }
     switch (chip8.nn()) // 0xFXNN (grab the 3rd and fourth nibble of the opcode)
     {
-        case 0x0A:
+        case 0x0A: handleFx0A(chip8); break;
+        case 0x1E: handleFx1E(chip8); break;
+        case 0x07: handleFx07(chip8); break;
+        case 0x15: handleFx15(chip8); break;
+        case 0x18: handleFx18(chip8); break;
+        case 0x29: handleFx29(chip8); break;
+        case 0x33: handleFx33(chip8); break;
+        case 0x55: handleFx55(chip8); break;
+        case 0x65: handleFx65(chip8); break;
+        default:
+            chip8.raiseTrap(TRAP_UNKNOWN_OPCODE);
+            break;
+    }
+}
+
+void Opcodes::handleF000(Chip8 &chip8)
+{
+    // I = the 16-bit address in the following word
+    chip8.I = chip8.memory[chip8.pc & chip8.addressMask] << 8 | chip8.memory[(chip8.pc + 1) & chip8.addressMask];
+    chip8.pc += 2;
+}
+
+void Opcodes::handleFn01(Chip8 &chip8)
+{
+    chip8.planeMask = chip8.x() & 0x3; // Select the planes later draws and clears touch
+}
+
+void Opcodes::handleF002(Chip8 &chip8)
+{
+    chip8.checkRange(chip8.I, sizeof(chip8.audioPattern));
+    for (int i = 0; i < 16; ++i)
+    {
+        chip8.audioPattern[i] = chip8.memory[(chip8.I + i) & chip8.addressMask]; // XO-CHIP audio pattern from I
+    }
+    chip8.patternLoaded = true;
+    chip8.soundChanged = true;
+}
+
+void Opcodes::handleFx0A(Chip8 &chip8)
+{
+    if (!chip8.waitingForKeyRelease)
+    {
+        for (int i = 0; i < 16; ++i)
         {
-            if (!chip8.waitingForKeyRelease) 
+            if (chip8.keypad[i])
             {
-                for (int i = 0; i < 16; ++i) 
-                {
-                    if (chip8.keypad[i]) 
-                    {
-                        chip8.lastkeyPressed = i;
-                        chip8.waitingForKeyRelease = true;
-                        chip8.pc -= 2; // Wait for release
-                        return;
-                    }
-                }
-                chip8.pc -= 2; // No key pressed, keep waiting
+                chip8.lastkeyPressed = i;
+                chip8.waitingForKeyRelease = true;
+                chip8.pc -= 2; // Wait for release
                 return;
-            } 
-            else 
-            {
-                // Wait for the key to be released
-                if (!chip8.keypad[chip8.lastkeyPressed]) {
-                    chip8.V[chip8.x()] = chip8.lastkeyPressed;
-                    chip8.waitingForKeyRelease = false;
-                    chip8.lastkeyPressed = -1;
-                    // Continue execution
-                } 
-                else 
-                {
-                    chip8.pc -= 2; // Still waiting for release
-                    return;
-                }
             }
-            break;
         }
-        case 0x1E:
-            chip8.I += chip8.V[chip8.x()]; // Add Vx to I
-            break;
-        case 0x07:  
-            chip8.V[chip8.x()] = chip8.delayTimer; // Set VX to the value of the delay timer
-            break;
-        case 0x15:
-            chip8.delayTimer = chip8.V[chip8.x()]; // Set the delay timer to the value of VX
-            break;
-        case 0x18:
-            chip8.soundTimer = chip8.V[chip8.x()]; // Set the sound timer to the value of VX
-            break;
-        case 0x29:
-            chip8.I = 0x50 + (chip8.V[chip8.x()] * 5); // Set I to the address of the font sprite for Vx
-            break;
-        case 0x33:
-            // Store BCD representation of Vx in memory at I, I+1, I+2
-            chip8.memory[chip8.I] = chip8.V[chip8.x()] / 100; // Hundreds place
-            chip8.memory[chip8.I + 1] = (chip8.V[chip8.x()] / 10) % 10; // Tens place
-            chip8.memory[chip8.I + 2] = chip8.V[chip8.x()] % 10; // Ones place
-            break;
-        case 0x55:
-            // Store registers V0 to Vx in memory starting at address I
-            for (int i = 0; i <= chip8.x(); ++i) 
+        chip8.pc -= 2; // No key pressed, keep waiting
+        return;
+    }
+    else
+    {
+        // Wait for the key to be released
+        if (!chip8.keypad[chip8.lastkeyPressed]) {
+            chip8.V[chip8.x()] = chip8.lastkeyPressed;
+            chip8.waitingForKeyRelease = false;
+            chip8.lastkeyPressed = -1;
+            // Continue execution
+        }
+        else
+        {
+            chip8.pc -= 2; // Still waiting for release
+            return;
+        }
+    }
+}
+
+void Opcodes::handleFx1E(Chip8 &chip8)
+{
+    chip8.I += chip8.V[chip8.x()]; // Add Vx to I
+}
+
+void Opcodes::handleFx07(Chip8 &chip8)
+{
+    chip8.V[chip8.x()] = chip8.delayTimer; // Set VX to the value of the delay timer
+}
+
+void Opcodes::handleFx15(Chip8 &chip8)
+{
+    chip8.delayTimer = chip8.V[chip8.x()]; // Set the delay timer to the value of VX
+}
+
+void Opcodes::handleFx18(Chip8 &chip8)
+{
+    chip8.soundTimer = chip8.V[chip8.x()]; // Set the sound timer to the value of VX
+}
+
+void Opcodes::handleFx29(Chip8 &chip8)
+{
+    chip8.I = 0x50 + (chip8.V[chip8.x()] * 5); // Set I to the address of the font sprite for Vx
+}
+
+void Opcodes::handleFx33(Chip8 &chip8)
+{
+    // Store BCD representation of Vx in memory at I, I+1, I+2
+    chip8.checkRange(chip8.I, 3);
+    chip8.memory[chip8.I & chip8.addressMask] = chip8.V[chip8.x()] / 100; // Hundreds place
+    chip8.memory[(chip8.I + 1) & chip8.addressMask] = (chip8.V[chip8.x()] / 10) % 10; // Tens place
+    chip8.memory[(chip8.I + 2) & chip8.addressMask] = chip8.V[chip8.x()] % 10; // Ones place
+    chip8.invalidateDecodeCache(chip8.I, 3);
+}
+
+void Opcodes::handleFx3A(Chip8 &chip8)
+{
+    chip8.pitch = chip8.V[chip8.x()]; // XO-CHIP pattern playback rate
+    chip8.soundChanged = true;
+}
+
+void Opcodes::handleFx55(Chip8 &chip8)
+{
+    // Store registers V0 to Vx in memory starting at address I
+    chip8.checkRange(chip8.I, chip8.x() + 1);
+    for (int i = 0; i <= chip8.x(); ++i)
+    {
+        chip8.memory[(chip8.I + i) & chip8.addressMask] = chip8.V[i];
+    }
+    chip8.invalidateDecodeCache(chip8.I, chip8.x() + 1);
+    if (chip8.quirks.memoryIncrement)
+        chip8.I += 1 + chip8.x(); // QUIRK - Increment I by the number of registers stored + 1 - Configure with memoryIncrement
+}
+
+void Opcodes::handleFx65(Chip8 &chip8)
+{
+    // Read registers V0 to Vx from memory starting at address I
+    chip8.checkRange(chip8.I, chip8.x() + 1);
+    for (int i = 0; i <= chip8.x(); ++i)
+    {
+        chip8.V[i] = chip8.memory[(chip8.I + i) & chip8.addressMask];
+    }
+    if (chip8.quirks.memoryIncrement)
+        chip8.I += 1 + chip8.x(); // QUIRK - Increment I by the number of registers read + 1 - Configure with memoryIncrement
+}
+
+OpcodeHandler Opcodes::decode(uint16_t opcode)
+{
+    // Resolve the leaf handler up front so cached instructions skip the second-level switch.
+    // Anything unknown falls back to its group handler, which reports it exactly as before.
+    uint8_t nn = opcode & 0x00FF;
+    switch (opcode >> 12)
+    {
+        case 0x0:
+            if ((opcode & 0xFFF0) == 0x00C0)
+                return &handle00Cn;
+            if ((opcode & 0xFFF0) == 0x00D0)
+                return &handle00Dn;
+            switch (opcode)
             {
-                chip8.memory[chip8.I + i] = chip8.V[i];
+                case 0x00E0: return &handle00E0;
+                case 0x00EE: return &handle00EE;
+                case 0x00FB: return &handle00FB;
+                case 0x00FC: return &handle00FC;
+                case 0x00FD: return &handle00FD;
+                case 0x00FE: return &handle00FE;
+                case 0x00FF: return &handle00FF;
             }
-            chip8.I += 1 + chip8.x(); // QUIRK - Increment I by the number of registers stored + 1 - Configure with chip mode
-            break;
-        case 0x65:
-            // Read registers V0 to Vx from memory starting at address I
-            for (int i = 0; i <= chip8.x(); ++i)
+            return &handle0;
+        case 0x1: return &handle1;
+        case 0x2: return &handle2;
+        case 0x3: return &handle3;
+        case 0x4: return &handle4;
+        case 0x5:
+            switch (opcode & 0x000F)
             {
-                chip8.V[i] = chip8.memory[chip8.I + i];
+                case 0x2: return &handle5xy2;
+                case 0x3: return &handle5xy3;
             }
-            chip8.I += 1 + chip8.x(); // QUIRK - Increment I by the number of registers read + 1 - Configure with chip mode
-            break;
+            return &handle5;
+        case 0x6: return &handle6;
+        case 0x7: return &handle7;
+        case 0x8:
+            switch (opcode & 0x000F)
+            {
+                case 0x0: return &handle8xy0;
+                case 0x1: return &handle8xy1;
+                case 0x2: return &handle8xy2;
+                case 0x3: return &handle8xy3;
+                case 0x4: return &handle8xy4;
+                case 0x5: return &handle8xy5;
+                case 0x6: return &handle8xy6;
+                case 0x7: return &handle8xy7;
+                case 0xE: return &handle8xyE;
+            }
+            return &handle8;
+        case 0x9: return &handle9;
+        case 0xA: return &handleA;
+        case 0xB: return &handleB;
+        case 0xC: return &handleC;
+        case 0xD: return &handleD;
+        case 0xE:
+            switch (nn)
+            {
+                case 0x9E: return &handleEx9E;
+                case 0xA1: return &handleExA1;
+            }
+            return &handleE;
         default:
-            std::cerr << "Unknown opcode: " << chip8.opcode() << std::endl;
-            break;
+            if (opcode == 0xF000)
+                return &handleF000;
+            if (opcode == 0xF002)
+                return &handleF002;
+            switch (nn)
+            {
+                case 0x01: return &handleFn01;
+                case 0x0A: return &handleFx0A;
+                case 0x1E: return &handleFx1E;
+                case 0x07: return &handleFx07;
+                case 0x15: return &handleFx15;
+                case 0x18: return &handleFx18;
+                case 0x29: return &handleFx29;
+                case 0x33: return &handleFx33;
+                case 0x3A: return &handleFx3A;
+                case 0x55: return &handleFx55;
+                case 0x65: return &handleFx65;
+            }
+            return &handleF;
+    }
+}
+
+namespace
+{
+    // Quirk-dependent handlers with the quirks fixed at compile time, one copy per combination
+    template <unsigned Q>
+    void handle8xy1Quirk(Chip8 &chip8)
+    {
+        chip8.V[chip8.x()] |= chip8.V[chip8.y()];
+        if constexpr ((Q & QUIRK_VF_RESET) != 0)
+            chip8.V[0xF] = 0;
+    }
+
+    template <unsigned Q>
+    void handle8xy2Quirk(Chip8 &chip8)
+    {
+        chip8.V[chip8.x()] &= chip8.V[chip8.y()];
+        if constexpr ((Q & QUIRK_VF_RESET) != 0)
+            chip8.V[0xF] = 0;
+    }
+
+    template <unsigned Q>
+    void handle8xy3Quirk(Chip8 &chip8)
+    {
+        chip8.V[chip8.x()] ^= chip8.V[chip8.y()];
+        if constexpr ((Q & QUIRK_VF_RESET) != 0)
+            chip8.V[0xF] = 0;
+    }
+
+    template <unsigned Q>
+    void handle8xy6Quirk(Chip8 &chip8)
+    {
+        uint8_t value = (Q & QUIRK_SHIFTING) ? chip8.V[chip8.x()] : chip8.V[chip8.y()];
+        chip8.V[chip8.x()] = value >> 1;
+        chip8.V[0xF] = value & 0x1;
     }
+
+    template <unsigned Q>
+    void handle8xyEQuirk(Chip8 &chip8)
+    {
+        uint8_t value = (Q & QUIRK_SHIFTING) ? chip8.V[chip8.x()] : chip8.V[chip8.y()];
+        chip8.V[chip8.x()] = value << 1;
+        chip8.V[0xF] = value >> 7;
+    }
+
+    template <unsigned Q>
+    void handleBQuirk(Chip8 &chip8)
+    {
+        chip8.pc = chip8.nnn() + chip8.V[(Q & QUIRK_JUMPING) ? chip8.x() : 0];
+    }
+
+    template <unsigned Q>
+    void handleDQuirk(Chip8 &chip8)
+    {
+        if constexpr ((Q & QUIRK_CLIPPING) != 0)
+            chip8.updatec8display();
+        else
+            chip8.updatec8displayWrapping();
+    }
+
+    template <unsigned Q>
+    void handleFx55Quirk(Chip8 &chip8)
+    {
+        chip8.checkRange(chip8.I, chip8.x() + 1);
+        for (int i = 0; i <= chip8.x(); ++i)
+        {
+            chip8.memory[(chip8.I + i) & chip8.addressMask] = chip8.V[i];
+        }
+        chip8.invalidateDecodeCache(chip8.I, chip8.x() + 1);
+        if constexpr ((Q & QUIRK_MEMORY_INCREMENT) != 0)
+            chip8.I += 1 + chip8.x();
+    }
+
+    template <unsigned Q>
+    void handleFx65Quirk(Chip8 &chip8)
+    {
+        chip8.checkRange(chip8.I, chip8.x() + 1);
+        for (int i = 0; i <= chip8.x(); ++i)
+        {
+            chip8.V[i] = chip8.memory[(chip8.I + i) & chip8.addressMask];
+        }
+        if constexpr ((Q & QUIRK_MEMORY_INCREMENT) != 0)
+            chip8.I += 1 + chip8.x();
+    }
+
+    template <unsigned Q>
+    OpcodeHandler decodeQuirk(uint16_t opcode)
+    {
+        OpcodeHandler handler = Opcodes::decode(opcode);
+        if constexpr ((Q & QUIRK_XO_CHIP) == 0)
+        {
+            // Not opcodes on the other platforms, the group handlers treat them as they always did
+            if (handler == &Opcodes::handle5xy2 || handler == &Opcodes::handle5xy3) return &Opcodes::handle5;
+            if (handler == &Opcodes::handleF000 || handler == &Opcodes::handleFn01 || handler == &Opcodes::handleF002
+                || handler == &Opcodes::handleFx3A) return &Opcodes::handleF;
+            if (handler == &Opcodes::handle00Dn) return &Opcodes::handle0;
+        }
+        if (handler == &Opcodes::handle8xy1) return &handle8xy1Quirk<Q>;
+        if (handler == &Opcodes::handle8xy2) return &handle8xy2Quirk<Q>;
+        if (handler == &Opcodes::handle8xy3) return &handle8xy3Quirk<Q>;
+        if (handler == &Opcodes::handle8xy6) return &handle8xy6Quirk<Q>;
+        if (handler == &Opcodes::handle8xyE) return &handle8xyEQuirk<Q>;
+        if (handler == &Opcodes::handleB) return &handleBQuirk<Q>;
+        if (handler == &Opcodes::handleD) return &handleDQuirk<Q>;
+        if (handler == &Opcodes::handleFx55) return &handleFx55Quirk<Q>;
+        if (handler == &Opcodes::handleFx65) return &handleFx65Quirk<Q>;
+        return handler;
+    }
+
+    template <unsigned... Q>
+    constexpr std::array<OpcodeDecoder, sizeof...(Q)> decoderTable(std::integer_sequence<unsigned, Q...>)
+    {
+        return { &decodeQuirk<Q>... };
+    }
+
+    constexpr auto decoders = decoderTable(std::make_integer_sequence<unsigned, QUIRK_COMBINATIONS>());
+}
+
+OpcodeDecoder Opcodes::decoderFor(unsigned quirkBits)
+{
+    return decoders[quirkBits % QUIRK_COMBINATIONS];
 }
@@ -1,9 +1,14 @@
 #pragma once
+#include <cstdint>
 class Chip8; //Using forward declaration to avoid circular dependency
 
+using OpcodeHandler = void (*)(Chip8&);
+using OpcodeDecoder = OpcodeHandler (*)(uint16_t opcode);
+
 class Opcodes
 {
     public:
+        // First-level handlers, dispatched on the top nibble
         static void handle0(Chip8& chip8);
         static void handle1(Chip8& chip8);
         static void handle2(Chip8& chip8);
@@ -20,4 +25,47 @@ class Opcodes
         static void handleD(Chip8& chip8);
         static void handleE(Chip8& chip8);
         static void handleF(Chip8& chip8);
-};
\ No newline at end of file
+
+        // Leaf handlers for the groups that switch on a sub-opcode
+        static void handle00Cn(Chip8& chip8);
+        static void handle00Dn(Chip8& chip8);
+        static void handle00E0(Chip8& chip8);
+        static void handle00EE(Chip8& chip8);
+        static void handle00FB(Chip8& chip8);
+        static void handle00FC(Chip8& chip8);
+        static void handle00FD(Chip8& chip8);
+        static void handle00FE(Chip8& chip8);
+        static void handle00FF(Chip8& chip8);
+        static void handle5xy2(Chip8& chip8);
+        static void handle5xy3(Chip8& chip8);
+        static void handle8xy0(Chip8& chip8);
+        static void handle8xy1(Chip8& chip8);
+        static void handle8xy2(Chip8& chip8);
+        static void handle8xy3(Chip8& chip8);
+        static void handle8xy4(Chip8& chip8);
+        static void handle8xy5(Chip8& chip8);
+        static void handle8xy6(Chip8& chip8);
+        static void handle8xy7(Chip8& chip8);
+        static void handle8xyE(Chip8& chip8);
+        static void handleEx9E(Chip8& chip8);
+        static void handleExA1(Chip8& chip8);
+        static void handleF000(Chip8& chip8);
+        static void handleFn01(Chip8& chip8);
+        static void handleF002(Chip8& chip8);
+        static void handleFx07(Chip8& chip8);
+        static void handleFx0A(Chip8& chip8);
+        static void handleFx15(Chip8& chip8);
+        static void handleFx18(Chip8& chip8);
+        static void handleFx1E(Chip8& chip8);
+        static void handleFx29(Chip8& chip8);
+        static void handleFx33(Chip8& chip8);
+        static void handleFx3A(Chip8& chip8);
+        static void handleFx55(Chip8& chip8);
+        static void handleFx65(Chip8& chip8);
+
+        // The handlers above read chip8.quirks as they run and serve as the reference behaviour.
+        // decode returns them, decoderFor returns a decode whose quirk-dependent handlers have the
+        // quirks compiled in. Both agree on every opcode apart from those handlers.
+        static OpcodeHandler decode(uint16_t opcode); // Returns the leaf handler for a full opcode
+        static OpcodeDecoder decoderFor(unsigned quirkBits);
+};
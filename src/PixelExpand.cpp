@@ -0,0 +1,83 @@
+#include "PixelExpand.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SDL_C8_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SDL_C8_NEON 1
+#endif
+
+namespace
+{
+    // For every 4-pixel nibble, an all-ones lane per lit pixel (leftmost pixel in the top bit)
+    struct nibbleMasks
+    {
+        alignas(16) uint32_t lanes[16][4];
+        nibbleMasks()
+        {
+            for (int nibble = 0; nibble < 16; ++nibble)
+            {
+                for (int lane = 0; lane < 4; ++lane)
+                {
+                    lanes[nibble][lane] = (nibble >> (3 - lane)) & 1 ? 0xFFFFFFFF : 0;
+                }
+            }
+        }
+    };
+    const nibbleMasks masks;
+}
+
+void PixelExpand::expandRow(const uint64_t plane0[2], const uint64_t plane1[2], uint32_t *out, const uint32_t palette[4])
+{
+    // Both planes in one pass: plane 0 picks within each half of the palette, plane 1 picks the half
+#if defined(SDL_C8_SSE2)
+    const __m128i color0 = _mm_set1_epi32(static_cast<int>(palette[0]));
+    const __m128i color1 = _mm_set1_epi32(static_cast<int>(palette[1]));
+    const __m128i color2 = _mm_set1_epi32(static_cast<int>(palette[2]));
+    const __m128i color3 = _mm_set1_epi32(static_cast<int>(palette[3]));
+    for (int word = 0; word < 2; ++word)
+    {
+        uint64_t bits0 = plane0[word];
+        uint64_t bits1 = plane1[word];
+        for (int shift = 60; shift >= 0; shift -= 4, out += 4)
+        {
+            __m128i mask0 = _mm_load_si128(reinterpret_cast<const __m128i *>(masks.lanes[(bits0 >> shift) & 0xF]));
+            __m128i mask1 = _mm_load_si128(reinterpret_cast<const __m128i *>(masks.lanes[(bits1 >> shift) & 0xF]));
+            __m128i low = _mm_or_si128(_mm_and_si128(mask0, color1), _mm_andnot_si128(mask0, color0));
+            __m128i high = _mm_or_si128(_mm_and_si128(mask0, color3), _mm_andnot_si128(mask0, color2));
+            __m128i pixels = _mm_or_si128(_mm_and_si128(mask1, high), _mm_andnot_si128(mask1, low));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), pixels);
+        }
+    }
+#elif defined(SDL_C8_NEON)
+    const uint32x4_t color0 = vdupq_n_u32(palette[0]);
+    const uint32x4_t color1 = vdupq_n_u32(palette[1]);
+    const uint32x4_t color2 = vdupq_n_u32(palette[2]);
+    const uint32x4_t color3 = vdupq_n_u32(palette[3]);
+    for (int word = 0; word < 2; ++word)
+    {
+        uint64_t bits0 = plane0[word];
+        uint64_t bits1 = plane1[word];
+        for (int shift = 60; shift >= 0; shift -= 4, out += 4)
+        {
+            uint32x4_t mask0 = vld1q_u32(masks.lanes[(bits0 >> shift) & 0xF]);
+            uint32x4_t mask1 = vld1q_u32(masks.lanes[(bits1 >> shift) & 0xF]);
+            uint32x4_t low = vbslq_u32(mask0, color1, color0);
+            uint32x4_t high = vbslq_u32(mask0, color3, color2);
+            vst1q_u32(out, vbslq_u32(mask1, high, low));
+        }
+    }
+#else
+    expandRowScalar(plane0, plane1, out, palette);
+#endif
+}
+
+void PixelExpand::expandRowScalar(const uint64_t plane0[2], const uint64_t plane1[2], uint32_t *out, const uint32_t palette[4])
+{
+    for (int x = 0; x < 128; ++x)
+    {
+        int shift = 63 - (x & 63);
+        out[x] = palette[((plane0[x >> 6] >> shift) & 1) | ((plane1[x >> 6] >> shift) & 1) << 1];
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+
+// Expands packed framebuffer rows into 32-bit texture pixels through a four-colour palette
+class PixelExpand
+{
+    public:
+        // 128 pixels from the same display row of both planes, bit 63 of word 0 first. Each pixel is
+        // palette[plane0 bit | plane1 bit << 1]. Uses SSE2/NEON when available.
+        static void expandRow(const uint64_t plane0[2], const uint64_t plane1[2], uint32_t* out, const uint32_t palette[4]);
+        static void expandRowScalar(const uint64_t plane0[2], const uint64_t plane1[2], uint32_t* out, const uint32_t palette[4]);
+};
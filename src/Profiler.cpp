@@ -0,0 +1,179 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    const double HUD_WINDOW_SECONDS = 0.5;
+
+    // Every group and sub-op that was executed at least once, most executed first
+    std::vector<std::pair<std::string, uint64_t>> opcodesByCount(const Profiler &profiler)
+    {
+        std::vector<std::pair<std::string, uint64_t>> opcodes;
+        for (int group = 0; group < 16; ++group)
+        {
+            for (int sub = 0; sub < 256; ++sub)
+            {
+                if (profiler.opcodeCounts[group][sub])
+                    opcodes.emplace_back(Profiler::opcodeName(group, sub), profiler.opcodeCounts[group][sub]);
+            }
+        }
+        std::stable_sort(opcodes.begin(), opcodes.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+        return opcodes;
+    }
+}
+
+Profiler::Scope::Scope(Profiler *profiler, profilePhase phase)
+    : profiler(profiler), phase(phase)
+{
+    if (profiler)
+        start = std::chrono::steady_clock::now();
+}
+
+Profiler::Scope::~Scope()
+{
+    if (profiler)
+        profiler->addPhase(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+void Profiler::addPhase(profilePhase phase, uint64_t nanoseconds)
+{
+    phaseNanoseconds[phase] += nanoseconds;
+    frameNanoseconds += nanoseconds;
+}
+
+void Profiler::endFrame()
+{
+    ++frames;
+    double ms = frameNanoseconds / 1e6;
+    smoothedFrameMs = frames == 1 ? ms : smoothedFrameMs * 0.9 + ms * 0.1; // Steady enough to read on screen
+    frameNanoseconds = 0;
+
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - windowStart).count();
+    if (seconds >= HUD_WINDOW_SECONDS)
+    {
+        uint64_t total = instructions.load(std::memory_order_relaxed);
+        ips = (total - windowInstructions) / seconds;
+        windowInstructions = total;
+        windowStart = now;
+    }
+}
+
+uint8_t Profiler::subOp(uint16_t opcode)
+{
+    switch (opcode >> 12)
+    {
+        case 0x0:
+        {
+            uint8_t low = opcode & 0xFF;
+            return (low & 0xF0) == 0xC0 || (low & 0xF0) == 0xD0 ? low & 0xF0 : low; // Scrolls by n count as one sub-op
+        }
+        case 0x5: case 0x8: case 0x9: return opcode & 0xF;
+        case 0xE: case 0xF: return opcode & 0xFF;
+        default: return 0;
+    }
+}
+
+std::string Profiler::opcodeName(uint8_t group, uint8_t subOp)
+{
+    static const char *const fixed[16] = {
+        nullptr, "1nnn", "2nnn", "3xnn", "4xnn", nullptr, "6xnn", "7xnn",
+        nullptr, nullptr, "Annn", "Bnnn", "Cxnn", "Dxyn", nullptr, nullptr
+    };
+    char name[8];
+    switch (group & 0xF)
+    {
+        case 0x0:
+            if (subOp == 0xC0 || subOp == 0xD0)
+                snprintf(name, sizeof(name), "00%Xn", subOp >> 4);
+            else
+                snprintf(name, sizeof(name), "00%02X", subOp);
+            return name;
+        case 0x5: case 0x8: case 0x9:
+            snprintf(name, sizeof(name), "%Xxy%X", group, subOp & 0xF);
+            return name;
+        case 0xE: case 0xF:
+            snprintf(name, sizeof(name), "%Xx%02X", group, subOp);
+            return name;
+        default:
+            return fixed[group & 0xF];
+    }
+}
+
+const char *Profiler::phaseName(profilePhase phase)
+{
+    static const char *const names[PHASE_COUNT] = { "input", "emulate", "draw", "upload", "present" };
+    return names[phase];
+}
+
+bool Profiler::writeJson(const std::string &path) const
+{
+    std::ofstream out(path);
+    if (!out)
+        return false;
+    out << "{\n  \"instructions\": " << instructions.load(std::memory_order_relaxed) << ",\n";
+    out << "  \"frames\": " << frames << ",\n";
+    out << "  \"phases_us\": {";
+    for (int phase = 0; phase < PHASE_COUNT; ++phase)
+    {
+        out << (phase ? ", " : " ") << "\"" << phaseName(static_cast<profilePhase>(phase)) << "\": " << phaseNanoseconds[phase] / 1000;
+    }
+    out << " },\n  \"opcodes\": [";
+    bool first = true;
+    for (const auto &opcode : opcodesByCount(*this))
+    {
+        out << (first ? "\n" : ",\n") << "    { \"op\": \"" << opcode.first << "\", \"count\": " << opcode.second << " }";
+        first = false;
+    }
+    out << "\n  ],\n  \"pc_hits\": [";
+    std::vector<std::pair<uint64_t, int>> hot; // Hits and PC, hottest first
+    for (int pc = 0; pc < 4096; ++pc)
+    {
+        if (pcHits[pc])
+            hot.emplace_back(pcHits[pc], pc);
+    }
+    std::stable_sort(hot.begin(), hot.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+    first = true;
+    for (const auto &entry : hot)
+    {
+        char pc[8];
+        snprintf(pc, sizeof(pc), "0x%03X", entry.second);
+        out << (first ? "\n" : ",\n") << "    { \"pc\": \"" << pc << "\", \"hits\": " << entry.first << " }";
+        first = false;
+    }
+    out << "\n  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+bool Profiler::writeCollapsed(const std::string &path) const
+{
+    std::ofstream out(path);
+    if (!out)
+        return false;
+    for (int phase = 0; phase < PHASE_COUNT; ++phase)
+    {
+        if (phaseNanoseconds[phase] >= 1000)
+            out << "frame;" << phaseName(static_cast<profilePhase>(phase)) << " " << phaseNanoseconds[phase] / 1000 << "\n";
+    }
+    return static_cast<bool>(out);
+}
+
+bool Profiler::writeCollapsedOpcodes(const std::string &path) const
+{
+    std::ofstream out(path);
+    if (!out)
+        return false;
+    for (int group = 0; group < 16; ++group)
+    {
+        for (int sub = 0; sub < 256; ++sub)
+        {
+            if (opcodeCounts[group][sub])
+                out << "chip8;" << std::hex << std::uppercase << group << std::dec << "xxx;" << opcodeName(group, sub) << " " << opcodeCounts[group][sub] << "\n";
+        }
+    }
+    return static_cast<bool>(out);
+}
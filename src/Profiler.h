@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+enum profilePhase { PHASE_INPUT, PHASE_EMULATE, PHASE_DRAW, PHASE_UPLOAD, PHASE_PRESENT, PHASE_COUNT };
+
+// Optional instrumentation: opcode counts per group and sub-op, a PC hit histogram and host time
+// per frame phase. Chip8 only feeds the counters when built with the SDL_C8_PROFILER CMake option,
+// otherwise the hooks are compiled out. While a profiler is attached every instruction goes through
+// the decode cache loop so it can be counted, the threaded interpreter and JIT are bypassed.
+class Profiler
+{
+    public:
+        // Times one phase of the current host frame, does nothing for a null profiler
+        class Scope
+        {
+            public:
+                Scope(Profiler* profiler, profilePhase phase);
+                ~Scope();
+                Scope(const Scope&) = delete;
+                Scope& operator=(const Scope&) = delete;
+
+            private:
+                Profiler* profiler;
+                profilePhase phase;
+                std::chrono::steady_clock::time_point start;
+        };
+
+        void countInstruction(uint16_t pc, uint16_t opcode)
+        {
+            ++opcodeCounts[opcode >> 12][subOp(opcode)];
+            ++pcHits[pc & 0xFFF];
+        }
+        void addPhase(profilePhase phase, uint64_t nanoseconds);
+        void endFrame(); // Close the host frame the phases since the last call belong to
+
+        double instructionsPerSecond() const { return ips; } // Refreshed every half second, for the HUD
+        double frameMs() const { return smoothedFrameMs; } // Work per host frame excluding the pacing wait
+
+        bool writeJson(const std::string& path) const;
+        bool writeCollapsed(const std::string& path) const; // Host phases in microseconds, frame;emulate 1234
+        bool writeCollapsedOpcodes(const std::string& path) const; // Executions, chip8;8xxx;8xy4 1234
+
+        static uint8_t subOp(uint16_t opcode); // Index into the second dimension of opcodeCounts
+        static std::string opcodeName(uint8_t group, uint8_t subOp); // Pattern such as 8xy4, Fx1E or Dxyn
+        static const char* phaseName(profilePhase phase);
+
+        std::atomic<uint64_t> instructions{0}; // Added once per Chip8::run, read by the HUD from another thread
+        uint64_t opcodeCounts[16][256] = {};
+        uint64_t pcHits[4096] = {};
+        uint64_t phaseNanoseconds[PHASE_COUNT] = {};
+        uint64_t frames = 0;
+
+    private:
+        uint64_t frameNanoseconds = 0; // Phases so far in the current host frame
+        double smoothedFrameMs = 0;
+        double ips = 0;
+        std::chrono::steady_clock::time_point windowStart = std::chrono::steady_clock::now();
+        uint64_t windowInstructions = 0;
+};
@@ -0,0 +1,242 @@
+#include "RewindBuffer.h"
+#include <cstring>
+
+namespace
+{
+    constexpr size_t STATE_SIZE = sizeof(Chip8State);
+    constexpr size_t MIN_ZERO_RUN = 4; // Shorter zero gaps stay inside a literal, a new token would cost as much
+
+    void putVarint(std::vector<uint8_t> &out, size_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    size_t getVarint(const uint8_t *&in)
+    {
+        size_t value = 0;
+        for (int shift = 0;; shift += 7)
+        {
+            uint8_t byte = *in++;
+            value |= static_cast<size_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+    }
+}
+
+RewindBuffer::RewindBuffer(size_t arenaBytes, uint32_t keyframeInterval)
+    : arena(arenaBytes), keyframeInterval(keyframeInterval ? keyframeInterval : 1)
+{
+    scratch.reserve(STATE_SIZE * 2);
+}
+
+// Output is a sequence of (zero run, literal length, literal bytes) tokens over current ^ base
+void RewindBuffer::encode(const uint8_t *current, const uint8_t *base, std::vector<uint8_t> &out)
+{
+    static const uint8_t zeros[STATE_SIZE] = {};
+    if (!base)
+        base = zeros;
+    out.clear();
+    size_t i = 0;
+    while (i < STATE_SIZE)
+    {
+        size_t runStart = i;
+        // Unchanged bytes are the common case, skip them a word at a time
+        while (i + 8 <= STATE_SIZE)
+        {
+            uint64_t a, b;
+            memcpy(&a, current + i, 8);
+            memcpy(&b, base + i, 8);
+            if (a != b)
+                break;
+            i += 8;
+        }
+        while (i < STATE_SIZE && current[i] == base[i])
+            ++i;
+        size_t literalStart = i;
+        while (i < STATE_SIZE)
+        {
+            if (current[i] != base[i])
+            {
+                ++i;
+                continue;
+            }
+            size_t gap = i;
+            while (gap < STATE_SIZE && current[gap] == base[gap] && gap - i < MIN_ZERO_RUN)
+                ++gap;
+            if (gap - i >= MIN_ZERO_RUN || gap == STATE_SIZE)
+                break;
+            i = gap;
+        }
+        putVarint(out, literalStart - runStart);
+        putVarint(out, i - literalStart);
+        for (size_t j = literalStart; j < i; ++j)
+        {
+            out.push_back(current[j] ^ base[j]);
+        }
+    }
+}
+
+void RewindBuffer::decode(const uint8_t *in, size_t length, const uint8_t *base, uint8_t *out)
+{
+    if (base)
+        memcpy(out, base, STATE_SIZE);
+    else
+        memset(out, 0, STATE_SIZE);
+    const uint8_t *end = in + length;
+    size_t position = 0;
+    while (in < end)
+    {
+        position += getVarint(in);
+        size_t literals = getVarint(in);
+        for (size_t j = 0; j < literals; ++j)
+        {
+            out[position++] ^= *in++;
+        }
+    }
+}
+
+void RewindBuffer::push(const Chip8 &chip8)
+{
+    const Chip8State &state = chip8;
+    bool keyframe = !keyValid || sinceKeyframe + 1 >= keyframeInterval;
+    encode(reinterpret_cast<const uint8_t*>(&state), keyframe ? nullptr : reinterpret_cast<const uint8_t*>(&keyState), scratch);
+
+    size_t offset;
+    if (!reserve(scratch.size(), offset))
+    {
+        return; // Arena smaller than one frame, nothing can be kept
+    }
+    if (!keyframe && entries.empty())
+    {
+        // Making room evicted the keyframe this delta was against, store a full frame instead
+        keyframe = true;
+        encode(reinterpret_cast<const uint8_t*>(&state), nullptr, scratch);
+        if (!reserve(scratch.size(), offset))
+            return;
+    }
+    memcpy(arena.data() + offset, scratch.data(), scratch.size());
+    entries.push_back({ offset, static_cast<uint32_t>(scratch.size()), keyframe });
+    head = offset + scratch.size();
+    if (keyframe)
+    {
+        keyState = state;
+        keyValid = true;
+        sinceKeyframe = 0;
+    }
+    else
+    {
+        ++sinceKeyframe;
+    }
+}
+
+bool RewindBuffer::pop(Chip8 &chip8)
+{
+    if (entries.empty())
+        return false;
+    rewindEntry entry = entries.back();
+    if (!entry.keyframe && !keyValid && !loadNewestKeyframe())
+        return false;
+    Chip8State state;
+    decode(arena.data() + entry.offset, entry.length, entry.keyframe ? nullptr : reinterpret_cast<const uint8_t*>(&keyState),
+           reinterpret_cast<uint8_t*>(&state));
+    entries.pop_back();
+    head = entry.offset; // The newest entry is always the last one written
+    if (entry.keyframe)
+    {
+        keyValid = false; // Its deltas are gone, the next delta needs the previous group's keyframe
+    }
+    else
+    {
+        --sinceKeyframe;
+    }
+    chip8.restoreState(state);
+    return true;
+}
+
+void RewindBuffer::clear()
+{
+    entries.clear();
+    head = 0;
+    keyValid = false;
+    sinceKeyframe = 0;
+}
+
+size_t RewindBuffer::bytesUsed() const
+{
+    size_t total = 0;
+    for (const rewindEntry &entry : entries)
+    {
+        total += entry.length;
+    }
+    return total;
+}
+
+bool RewindBuffer::loadNewestKeyframe()
+{
+    sinceKeyframe = 0;
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+    {
+        if (it->keyframe)
+        {
+            decode(arena.data() + it->offset, it->length, nullptr, reinterpret_cast<uint8_t*>(&keyState));
+            keyValid = true;
+            return true;
+        }
+        ++sinceKeyframe;
+    }
+    return false;
+}
+
+bool RewindBuffer::reserve(size_t length, size_t &offset)
+{
+    if (length > arena.size())
+        return false;
+    for (;;)
+    {
+        if (entries.empty())
+        {
+            offset = head + length <= arena.size() ? head : 0;
+            return true;
+        }
+        size_t oldest = entries.front().offset;
+        if (oldest >= head)
+        {
+            // Live data wraps around the end of the arena, the only free space is between head and the oldest entry
+            if (head + length <= oldest)
+            {
+                offset = head;
+                return true;
+            }
+        }
+        else if (head + length <= arena.size())
+        {
+            offset = head;
+            return true;
+        }
+        else if (length <= oldest)
+        {
+            offset = 0;
+            return true;
+        }
+        evictOldestGroup();
+    }
+}
+
+void RewindBuffer::evictOldestGroup()
+{
+    do
+    {
+        entries.pop_front();
+    } while (!entries.empty() && !entries.front().keyframe);
+    if (entries.empty())
+    {
+        keyValid = false;
+        sinceKeyframe = 0;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "Chip8.h"
+
+// Per-frame history of Chip8State for rewinding. Every keyframeInterval frames a full snapshot is
+// stored, the frames in between are stored as the XOR against that keyframe. Both are run-length
+// encoded (zero runs + literal bytes) into one fixed-size byte arena used as a ring, so memory
+// never grows: once the arena is full the oldest keyframe is dropped together with its deltas.
+class RewindBuffer
+{
+    public:
+        RewindBuffer(size_t arenaBytes = 8 << 20, uint32_t keyframeInterval = 120);
+
+        void push(const Chip8& chip8); // Capture the state at the end of a frame
+        bool pop(Chip8& chip8); // Restore the newest captured frame and forget it, false when empty
+        void clear();
+        size_t frames() const { return entries.size(); }
+        size_t bytesUsed() const; // Encoded bytes currently held
+
+    private:
+        struct rewindEntry
+        {
+            size_t offset; // Position in arena
+            uint32_t length;
+            bool keyframe; // Encoded against zeros rather than the group's keyframe
+        };
+
+        static void encode(const uint8_t* current, const uint8_t* base, std::vector<uint8_t>& out);
+        static void decode(const uint8_t* in, size_t length, const uint8_t* base, uint8_t* out);
+        bool reserve(size_t length, size_t& offset); // Make room in the arena, evicting the oldest groups
+        void evictOldestGroup();
+        bool loadNewestKeyframe(); // Rebuild keyState from the newest keyframe still held
+
+        std::vector<uint8_t> arena;
+        size_t head = 0; // Next write position in arena
+        std::deque<rewindEntry> entries; // Oldest first
+        uint32_t keyframeInterval;
+        uint32_t sinceKeyframe = 0; // Deltas stored after the newest keyframe
+        Chip8State keyState; // Decoded newest keyframe, base for new deltas
+        bool keyValid = false;
+        std::vector<uint8_t> scratch; // Encoder output, reused so capture does not allocate
+};
@@ -0,0 +1,453 @@
+#include "RomIndex.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+#include <utility>
+#include "WorkStealingPool.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SDL_C8_MMAP 1
+#endif
+
+namespace
+{
+    struct indexHeader
+    {
+        uint32_t magic = RomIndex::MAGIC;
+        uint32_t version = RomIndex::VERSION;
+        uint32_t slots = 0;
+        uint32_t count = 0;
+    };
+
+    // Just enough JSON for the database files, strings keep their escapes only as far as keys need
+    struct jsonValue
+    {
+        enum kind { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+        kind type = NUL;
+        double number = 0;
+        std::string text;
+        std::vector<jsonValue> items;
+        std::vector<std::pair<std::string, jsonValue>> members;
+
+        const jsonValue* get(const char* key) const
+        {
+            for (const auto &member : members)
+            {
+                if (member.first == key)
+                    return &member.second;
+            }
+            return nullptr;
+        }
+    };
+
+    class jsonParser
+    {
+        public:
+            jsonParser(const std::string& text) : at(text.data()), end(text.data() + text.size()) {}
+
+            bool parse(jsonValue& out)
+            {
+                return value(out) && (skipSpace(), at == end);
+            }
+
+        private:
+            const char* at;
+            const char* end;
+
+            void skipSpace()
+            {
+                while (at < end && (*at == ' ' || *at == '\t' || *at == '\n' || *at == '\r'))
+                    ++at;
+            }
+
+            bool literal(const char* word)
+            {
+                size_t length = strlen(word);
+                if (static_cast<size_t>(end - at) < length || memcmp(at, word, length) != 0)
+                    return false;
+                at += length;
+                return true;
+            }
+
+            bool string(std::string& out)
+            {
+                if (at == end || *at != '"')
+                    return false;
+                ++at;
+                while (at < end && *at != '"')
+                {
+                    if (*at != '\\')
+                    {
+                        out += *at++;
+                        continue;
+                    }
+                    if (++at == end)
+                        return false;
+                    switch (*at++)
+                    {
+                        case 'b': out += '\b'; break;
+                        case 'f': out += '\f'; break;
+                        case 'n': out += '\n'; break;
+                        case 'r': out += '\r'; break;
+                        case 't': out += '\t'; break;
+                        case 'u':
+                            if (end - at < 4)
+                                return false;
+                            at += 4;
+                            out += '?'; // Only titles and descriptions use these, neither is read
+                            break;
+                        default: out += at[-1]; // \" \\ and \/
+                    }
+                }
+                if (at == end)
+                    return false;
+                ++at;
+                return true;
+            }
+
+            bool value(jsonValue& out)
+            {
+                skipSpace();
+                if (at == end)
+                    return false;
+                switch (*at)
+                {
+                    case '"':
+                        out.type = jsonValue::STRING;
+                        return string(out.text);
+                    case '[':
+                        out.type = jsonValue::ARRAY;
+                        ++at;
+                        skipSpace();
+                        if (at < end && *at == ']')
+                            return ++at, true;
+                        for (;;)
+                        {
+                            out.items.emplace_back();
+                            if (!value(out.items.back()))
+                                return false;
+                            skipSpace();
+                            if (at < end && *at == ',')
+                                ++at;
+                            else
+                                return at < end && *at++ == ']';
+                        }
+                    case '{':
+                        out.type = jsonValue::OBJECT;
+                        ++at;
+                        skipSpace();
+                        if (at < end && *at == '}')
+                            return ++at, true;
+                        for (;;)
+                        {
+                            out.members.emplace_back();
+                            skipSpace();
+                            if (!string(out.members.back().first))
+                                return false;
+                            skipSpace();
+                            if (at == end || *at++ != ':' || !value(out.members.back().second))
+                                return false;
+                            skipSpace();
+                            if (at < end && *at == ',')
+                                ++at;
+                            else
+                                return at < end && *at++ == '}';
+                        }
+                    case 't':
+                        out.type = jsonValue::BOOLEAN;
+                        out.number = 1;
+                        return literal("true");
+                    case 'f':
+                        out.type = jsonValue::BOOLEAN;
+                        return literal("false");
+                    case 'n':
+                        return literal("null");
+                    default:
+                    {
+                        char* parsed = nullptr;
+                        std::string number(at, std::min<size_t>(end - at, 32));
+                        out.type = jsonValue::NUMBER;
+                        out.number = strtod(number.c_str(), &parsed);
+                        if (parsed == number.c_str())
+                            return false;
+                        at += parsed - number.c_str();
+                        return true;
+                    }
+                }
+            }
+    };
+
+    // CHIP-8 database platform ids, the first one a ROM lists that maps to a profile here wins
+    uint8_t platformProfile(const std::string &id)
+    {
+        if (id == "xochip") return ROM_PROFILE_XO_CHIP;
+        if (id == "superchip" || id == "superchip1" || id == "chip48") return ROM_PROFILE_SCHIP_LEGACY;
+        if (id == "originalChip8" || id == "hybridVIP" || id == "modernChip8") return ROM_PROFILE_CHIP8;
+        return ROM_PROFILE_NONE; // chip8x, megachip8 and the like have no profile here
+    }
+
+    bool parseSha1(const std::string &hex, uint8_t out[20])
+    {
+        if (hex.size() != 40)
+            return false;
+        for (int i = 0; i < 40; ++i)
+        {
+            char c = hex[i];
+            int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+            if (digit < 0)
+                return false;
+            out[i / 2] = static_cast<uint8_t>(i & 1 ? out[i / 2] | digit : digit << 4);
+        }
+        return true;
+    }
+
+    // programs.json: an array of programs, each with "roms" keyed by SHA-1 holding "platforms" and "tickrate"
+    bool readDatabase(const std::string &path, std::unordered_map<std::string, romIndexEntry> &known)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        jsonValue programs;
+        if (!jsonParser(text).parse(programs) || programs.type != jsonValue::ARRAY)
+            return false;
+        for (const jsonValue &program : programs.items)
+        {
+            const jsonValue *roms = program.get("roms");
+            if (!roms)
+                continue;
+            for (const auto &rom : roms->members)
+            {
+                romIndexEntry entry;
+                if (!parseSha1(rom.first, entry.sha1))
+                    continue;
+                if (const jsonValue *platforms = rom.second.get("platforms"))
+                {
+                    for (size_t i = 0; i < platforms->items.size() && entry.profile == ROM_PROFILE_NONE; ++i)
+                        entry.profile = platformProfile(platforms->items[i].text);
+                }
+                if (entry.profile == ROM_PROFILE_NONE)
+                    continue;
+                const jsonValue *tickrate = rom.second.get("tickrate");
+                if (tickrate && tickrate->type == jsonValue::NUMBER && tickrate->number >= 1)
+                    entry.instructionsPerFrame = static_cast<uint16_t>(std::min(tickrate->number, 65535.0));
+                known[std::string(reinterpret_cast<const char*>(entry.sha1), 20)] = entry;
+            }
+        }
+        return true;
+    }
+
+    bool hashFile(const std::string &path, uint8_t out[20])
+    {
+#ifdef SDL_C8_MMAP
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        bool ok = fstat(fd, &info) == 0;
+        if (ok && info.st_size == 0)
+        {
+            RomIndex::sha1(nullptr, 0, out);
+        }
+        else if (ok)
+        {
+            void *mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            ok = mapped != MAP_FAILED;
+            if (ok)
+            {
+                RomIndex::sha1(static_cast<const uint8_t*>(mapped), static_cast<size_t>(info.st_size), out);
+                munmap(mapped, static_cast<size_t>(info.st_size));
+            }
+        }
+        close(fd);
+        return ok;
+#else
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        RomIndex::sha1(bytes.data(), bytes.size(), out);
+        return true;
+#endif
+    }
+
+    uint32_t slotHash(const uint8_t sha1[20])
+    {
+        uint32_t hash;
+        memcpy(&hash, sha1, sizeof(hash));
+        return hash;
+    }
+}
+
+bool RomIndex::build(const std::vector<std::string> &roms, const std::string &databasePath, romIndexReport &report, unsigned threads)
+{
+    std::unordered_map<std::string, romIndexEntry> known;
+    if (!readDatabase(databasePath, known))
+        return false;
+
+    std::vector<romIndexEntry> hashed(roms.size());
+    std::vector<uint8_t> readable(roms.size());
+    std::vector<WorkStealingPool::task> tasks;
+    tasks.reserve(roms.size());
+    for (size_t i = 0; i < roms.size(); ++i)
+    {
+        tasks.push_back([&, i](unsigned) { readable[i] = hashFile(roms[i], hashed[i].sha1); });
+    }
+    WorkStealingPool::run(tasks, threads);
+
+    report = romIndexReport();
+    std::vector<romIndexEntry> matches;
+    for (size_t i = 0; i < roms.size(); ++i)
+    {
+        if (!readable[i])
+        {
+            ++report.unreadable;
+            continue;
+        }
+        ++report.roms;
+        auto found = known.find(std::string(reinterpret_cast<const char*>(hashed[i].sha1), 20));
+        if (found != known.end())
+        {
+            matches.push_back(found->second);
+            ++report.matched;
+        }
+    }
+
+    size_t size = 16;
+    while (size < matches.size() * 2)
+        size *= 2;
+    slots.assign(size, romIndexEntry());
+    count = 0;
+    for (const romIndexEntry &entry : matches)
+        insert(entry);
+    return true;
+}
+
+void RomIndex::insert(const romIndexEntry &entry)
+{
+    size_t mask = slots.size() - 1;
+    for (size_t slot = slotHash(entry.sha1) & mask;; slot = (slot + 1) & mask)
+    {
+        if (slots[slot].profile == ROM_PROFILE_NONE)
+        {
+            slots[slot] = entry;
+            ++count;
+            return;
+        }
+        if (memcmp(slots[slot].sha1, entry.sha1, 20) == 0)
+            return; // The same ROM under another name
+    }
+}
+
+const romIndexEntry* RomIndex::find(const uint8_t *rom, size_t romSize) const
+{
+    if (slots.empty())
+        return nullptr;
+    uint8_t hash[20];
+    sha1(rom, romSize, hash);
+    size_t mask = slots.size() - 1;
+    for (size_t slot = slotHash(hash) & mask; slots[slot].profile != ROM_PROFILE_NONE; slot = (slot + 1) & mask)
+    {
+        if (memcmp(slots[slot].sha1, hash, 20) == 0)
+            return &slots[slot];
+    }
+    return nullptr;
+}
+
+bool RomIndex::save(const std::string &path) const
+{
+    indexHeader header;
+    header.slots = static_cast<uint32_t>(slots.size());
+    header.count = static_cast<uint32_t>(count);
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(romIndexEntry));
+    return static_cast<bool>(file);
+}
+
+bool RomIndex::load(const std::string &path)
+{
+    slots.clear();
+    count = 0;
+    indexHeader header;
+    std::ifstream file(path, std::ios::binary);
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != MAGIC || header.version != VERSION
+        || header.slots == 0 || (header.slots & (header.slots - 1)) != 0 || header.count >= header.slots)
+    {
+        return false;
+    }
+    std::vector<romIndexEntry> read(header.slots);
+    if (!file.read(reinterpret_cast<char*>(read.data()), read.size() * sizeof(romIndexEntry)))
+        return false;
+    slots = std::move(read);
+    count = header.count;
+    return true;
+}
+
+const char* RomIndex::profileName(uint8_t profile)
+{
+    switch (profile)
+    {
+        case ROM_PROFILE_CHIP8: return "chip8";
+        case ROM_PROFILE_SCHIP_LEGACY: return "schip-legacy";
+        case ROM_PROFILE_SCHIP_MODERN: return "schip-modern";
+        case ROM_PROFILE_XO_CHIP: return "xo-chip";
+    }
+    return nullptr;
+}
+
+void RomIndex::sha1(const uint8_t *data, size_t length, uint8_t out[20])
+{
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    auto rotl = [](uint32_t value, int bits) { return (value << bits) | (value >> (32 - bits)); };
+    auto compress = [&](const uint8_t block[64])
+    {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i)
+            w[i] = uint32_t(block[i * 4]) << 24 | uint32_t(block[i * 4 + 1]) << 16 | uint32_t(block[i * 4 + 2]) << 8 | block[i * 4 + 3];
+        for (int i = 16; i < 80; ++i)
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i)
+        {
+            uint32_t f, k;
+            if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+            uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    };
+
+    size_t whole = length / 64 * 64;
+    for (size_t offset = 0; offset < whole; offset += 64)
+        compress(data + offset);
+    // Last partial block, the 0x80 terminator and the bit length, spilling into a second block if needed
+    uint8_t tail[128] = {};
+    size_t left = length - whole;
+    if (left)
+        memcpy(tail, data + whole, left);
+    tail[left] = 0x80;
+    size_t tailLength = left < 56 ? 64 : 128;
+    uint64_t bits = uint64_t(length) * 8;
+    for (int i = 0; i < 8; ++i)
+        tail[tailLength - 1 - i] = static_cast<uint8_t>(bits >> (i * 8));
+    compress(tail);
+    if (tailLength == 128)
+        compress(tail + 64);
+    for (int i = 0; i < 20; ++i)
+        out[i] = static_cast<uint8_t>(h[i / 4] >> (24 - (i % 4) * 8));
+}
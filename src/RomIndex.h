@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum romProfile : uint8_t
+{
+    ROM_PROFILE_NONE = 0, // Marks an empty slot
+    ROM_PROFILE_CHIP8,
+    ROM_PROFILE_SCHIP_LEGACY,
+    ROM_PROFILE_SCHIP_MODERN,
+    ROM_PROFILE_XO_CHIP
+};
+
+struct romIndexEntry
+{
+    uint8_t sha1[20];
+    uint8_t profile = ROM_PROFILE_NONE; // romProfile
+    uint8_t reserved = 0;
+    uint16_t instructionsPerFrame = 0; // 0 when the database gives no tickrate
+};
+static_assert(sizeof(romIndexEntry) == 24, "romIndexEntry is written to disk as is");
+
+struct romIndexReport
+{
+    size_t roms = 0; // Files hashed
+    size_t matched = 0; // Of those, the ones the database knows
+    size_t unreadable = 0;
+};
+
+// Known ROMs keyed by the SHA-1 of their image, each with the quirk profile and instructions per
+// frame it wants. Built by hashing a ROM library in parallel against a CHIP-8 database programs.json
+// and saved as an open-addressed table, so finding a ROM at load is one SHA-1 and a short probe
+// with no parsing. The table is indexed by the first four bytes of the hash, already uniform.
+class RomIndex
+{
+    public:
+        static constexpr uint32_t MAGIC = 0x49384353; // "SC8I" little-endian
+        static constexpr uint32_t VERSION = 1;
+
+        // Hash roms on a work-stealing pool and keep the ones databasePath lists, false if it cannot be read
+        bool build(const std::vector<std::string>& roms, const std::string& databasePath, romIndexReport& report, unsigned threads = 0);
+        bool save(const std::string& path) const;
+        bool load(const std::string& path); // False if missing or written by a different version, the index stays empty
+        const romIndexEntry* find(const uint8_t* rom, size_t romSize) const; // Null for ROMs not in the index
+        size_t size() const { return count; }
+
+        static const char* profileName(uint8_t profile); // Configuration profile name, null for ROM_PROFILE_NONE
+        static void sha1(const uint8_t* data, size_t length, uint8_t out[20]);
+
+    private:
+        void insert(const romIndexEntry& entry);
+        std::vector<romIndexEntry> slots; // Power-of-two sized, at most half full
+        size_t count = 0;
+};
@@ -1,40 +1,50 @@
 #include "SDLBeep.h"
+#include <algorithm>
 
 namespace {
-    constexpr int SAMPLE_RATE = 44100;
     constexpr SDL_AudioFormat AUDIO_FORMAT = SDL_AUDIO_S16LE;
     constexpr int CHANNELS = 1;
-    constexpr int SAMPLES = 4096;
-    constexpr int SQUARE_WAVE_FREQ = 440;
-    constexpr int16_t SQUARE_WAVE_HIGH = 32767/100;
-    constexpr int16_t SQUARE_WAVE_LOW = -32768/100;
+    constexpr int CHUNK_SAMPLES = 256; // Stack buffer the callback fills in pieces
+    const char *const DEVICE_SAMPLE_FRAMES = "256"; // About 6 ms per device buffer at 44.1 kHz
 }
 
 SDLBeep::SDLBeep()
 {
-    want.freq = SAMPLE_RATE;
+    want.freq = ToneGenerator::SAMPLE_RATE;
     want.format = AUDIO_FORMAT;
     want.channels = CHANNELS;
+    SDL_SetHint(SDL_HINT_AUDIO_DEVICE_SAMPLE_FRAMES, DEVICE_SAMPLE_FRAMES);
     stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &want, &audioCallback, this);
-    SDL_PauseAudioStreamDevice(stream);
+    // The device runs for the whole session, silence is generated rather than pausing it
+    SDL_ResumeAudioStreamDevice(stream);
 }
 
-void SDLBeep::audioCallback(void *userdata, SDL_AudioStream *stream, int additional_amount, int total_amount)
+SDLBeep::~SDLBeep()
 {
-    uint8_t buffer[SAMPLES * sizeof(int16_t)];
-    int16_t *data = reinterpret_cast<int16_t *>(buffer);
-    static uint32_t running_sample_index = 0;
-    int32_t square_wave_period = SAMPLE_RATE / SQUARE_WAVE_FREQ;
-
-    for (int i = 0; i < SAMPLES; ++i)
-    {
-        data[i] = (running_sample_index++ / (square_wave_period / 2)) % 2 == 0
-            ? SQUARE_WAVE_HIGH
-            : SQUARE_WAVE_LOW;
-    }
-
-    SDL_PutAudioStreamData(stream, buffer, SAMPLES * sizeof(int16_t));
+    SDL_DestroyAudioStream(stream);
 }
 
+void SDLBeep::setSoundTimer(uint8_t ticks)
+{
+    tone.setSoundTimer(ticks);
+}
 
+void SDLBeep::setPattern(const uint8_t *pattern, uint8_t pitch)
+{
+    tone.setPattern(pattern, pitch);
+}
 
+void SDLBeep::audioCallback(void *userdata, SDL_AudioStream *stream, int additional_amount, int total_amount)
+{
+    // Only top the stream up by what the device asked for, so nothing queues beyond its own buffer
+    SDLBeep *beeper = static_cast<SDLBeep *>(userdata);
+    int16_t buffer[CHUNK_SAMPLES];
+    int samples = additional_amount / static_cast<int>(sizeof(int16_t));
+    while (samples > 0)
+    {
+        int chunk = std::min(samples, CHUNK_SAMPLES);
+        beeper->tone.generate(buffer, chunk);
+        SDL_PutAudioStreamData(stream, buffer, chunk * static_cast<int>(sizeof(int16_t)));
+        samples -= chunk;
+    }
+}
@@ -1,11 +1,17 @@
 #include <SDL3/SDL.h>
+#include "Chip8IO.h"
+#include "ToneGenerator.h"
 #pragma once
 
-class SDLBeep
+class SDLBeep : public AudioOutput
 {
     public:
         SDL_AudioSpec want;
         SDL_AudioStream *stream;
+        ToneGenerator tone; // Owned by this device rather than shared
         SDLBeep();
+        ~SDLBeep();
+        void setSoundTimer(uint8_t ticks) override;
+        void setPattern(const uint8_t* pattern, uint8_t pitch) override;
         static void audioCallback(void *userdata, SDL_AudioStream *stream, int additional_amount, int total_amount);
-};
\ No newline at end of file
+};
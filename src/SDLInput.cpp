@@ -0,0 +1,81 @@
+#include "SDLInput.h"
+#include <SDL3/SDL.h>
+
+namespace
+{
+    int keypadIndex(SDL_Keycode key)
+    {
+        switch (key)
+        {
+            case SDLK_1: return 0x1;
+            case SDLK_2: return 0x2;
+            case SDLK_3: return 0x3;
+            case SDLK_4: return 0xC;
+            case SDLK_Q: return 0x4;
+            case SDLK_W: return 0x5;
+            case SDLK_E: return 0x6;
+            case SDLK_R: return 0xD;
+            case SDLK_A: return 0x7;
+            case SDLK_S: return 0x8;
+            case SDLK_D: return 0x9;
+            case SDLK_F: return 0xE;
+            case SDLK_Z: return 0xA;
+            case SDLK_X: return 0x0;
+            case SDLK_C: return 0xB;
+            case SDLK_V: return 0xF;
+        }
+        return -1;
+    }
+}
+
+void SDLInput::pollEvents(EmulationLoop &loop)
+{
+    SDL_Event event;
+    while (SDL_PollEvent(&event))
+    {
+        switch (event.type)
+        {
+            case SDL_EVENT_QUIT:
+                loop.quit = true;
+                break;
+            case SDL_EVENT_WINDOW_EXPOSED:
+            case SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED:
+                redraw = true;
+                break;
+            case SDL_EVENT_DROP_FILE:
+                if (event.drop.data)
+                    droppedFile = event.drop.data;
+                break;
+            case SDL_EVENT_KEY_DOWN:
+                if (event.key.repeat)
+                    break;
+                switch (event.key.key)
+                {
+                    case SDLK_ESCAPE:
+                        loop.quit = true;
+                        break;
+                    case SDLK_SPACE:
+                        loop.paused = !loop.paused;
+                        break;
+                    case SDLK_BACKSPACE: rewinding = true; break;
+                    case SDLK_TAB: turbo = true; break;
+                    default:
+                        if (keypadIndex(event.key.key) >= 0)
+                            loop.sendKey(static_cast<uint8_t>(keypadIndex(event.key.key)), true);
+                }
+                break;
+            case SDL_EVENT_KEY_UP:
+                switch (event.key.key)
+                {
+                    case SDLK_BACKSPACE: rewinding = false; break;
+                    case SDLK_TAB: turbo = false; break;
+                    default:
+                        if (keypadIndex(event.key.key) >= 0)
+                            loop.sendKey(static_cast<uint8_t>(keypadIndex(event.key.key)), false);
+                }
+                break;
+        }
+    }
+    loop.rewinding = rewinding;
+    loop.turbo = turbo;
+}
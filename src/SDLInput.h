@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+#include "EmulationLoop.h"
+
+// Turns SDL events into keypad events and host controls for an EmulationLoop. Runs on the SDL
+// thread, the emulation side never polls SDL itself.
+class SDLInput
+{
+    public:
+        void pollEvents(EmulationLoop& loop);
+        bool rewinding = false; // Backspace is held
+        bool turbo = false; // Tab is held
+        bool redraw = false; // The window was exposed or resized and needs presenting even without a new frame
+        std::string droppedFile; // Last file dropped on the window, for the host to load and clear
+};
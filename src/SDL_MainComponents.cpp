@@ -1,14 +1,31 @@
 #include "SDL_MainComponents.h"
 #include "Configuration.h"
+#include "PixelExpand.h"
+#include <cstdio>
+#include <cstring>
 #include <tuple>
 
 
 SDL_SmartPointer<SDL_Texture> SDL_MainComponents::display;
+uint64_t SDL_MainComponents::uploaded[DISPLAY_PLANES][64][2];
+uint32_t SDL_MainComponents::uploadedPalette[4];
+bool SDL_MainComponents::uploadedAny = false;
+Profiler* SDL_MainComponents::profiler = nullptr;
+bool SDL_MainComponents::showHud = false;
 
 void SDL_MainComponents::renderUpdate()
 {
+    Profiler::Scope scope(profiler, PHASE_PRESENT);
     SDL_RenderClear(renderer);
     SDL_RenderTexture(renderer, display.get(), NULL, NULL);
+    if (showHud && profiler)
+    {
+        char hud[64];
+        snprintf(hud, sizeof(hud), "%.2f MIPS  %.2f ms", profiler->instructionsPerSecond() / 1e6, profiler->frameMs());
+        SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0x00, 0xFF);
+        SDL_RenderDebugText(renderer, 4, 4, hud);
+        SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xFF);
+    }
     SDL_RenderPresent(renderer);
 }
 
@@ -16,4 +33,62 @@ void SDL_MainComponents::init()
 {
     window = SDL_CreateWindow("SDL Window", configuration::WINDOW_WIDTH * configuration::SCALE_FACTOR, configuration::WINDOW_HEIGHT * configuration::SCALE_FACTOR, SDL_WINDOW_RESIZABLE);
     renderer = SDL_CreateRenderer(window, nullptr);
-}
\ No newline at end of file
+    // One long-lived streaming texture, rows are rewritten in place as the framebuffer changes
+    display.reset(SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, configuration::WINDOW_WIDTH, configuration::WINDOW_HEIGHT));
+    SDL_SetTextureScaleMode(display.get(), SDL_SCALEMODE_NEAREST);
+    uploadedAny = false;
+}
+
+void SDL_MainComponents::updateDisplayTexture(const frameSnapshot &frame)
+{
+    // Frames can be skipped on the way here, so dirty rows come from comparing against what was last uploaded
+    Profiler::Scope drawScope(profiler, PHASE_DRAW);
+    uint64_t dirtyRows = 0;
+    if (!uploadedAny || memcmp(uploadedPalette, configuration::palette, sizeof(uploadedPalette)) != 0)
+    {
+        dirtyRows = ~0ull; // First frame or palette changed, every row needs expanding
+    }
+    for (int y = 0; y < 64; y++)
+    {
+        uint64_t changed = 0;
+        for (int plane = 0; plane < DISPLAY_PLANES; plane++)
+        {
+            changed |= (frame.display[plane][y][0] ^ uploaded[plane][y][0]) | (frame.display[plane][y][1] ^ uploaded[plane][y][1]);
+        }
+        if (changed)
+        {
+            dirtyRows |= 1ull << y;
+        }
+    }
+    if (!dirtyRows)
+    {
+        return; // Nothing drawn since the last upload, the texture is still current
+    }
+    Profiler::Scope uploadScope(profiler, PHASE_UPLOAD); // Nested in draw, reported separately
+
+    // Locked pixels are write-only, so lock the span from the first to the last dirty row and fill all of it
+    int first = __builtin_ctzll(dirtyRows);
+    int last = 63 - __builtin_clzll(dirtyRows);
+    SDL_Rect rect = { 0, first, configuration::WINDOW_WIDTH, last - first + 1 };
+    void *pixels;
+    int pitch;
+    if (!SDL_LockTexture(display.get(), &rect, &pixels, &pitch))
+    {
+        return; // Nothing recorded as uploaded, the same rows are tried again with the next frame
+    }
+    memcpy(uploaded, frame.display, sizeof(uploaded));
+    memcpy(uploadedPalette, configuration::palette, sizeof(uploadedPalette));
+    uploadedAny = true;
+    for (int y = first; y <= last; y++)
+    {
+        uint32_t *row = reinterpret_cast<uint32_t *>(static_cast<uint8_t *>(pixels) + (y - first) * pitch);
+        PixelExpand::expandRow(frame.display[0][y], frame.display[1][y], row, configuration::palette);
+    }
+    SDL_UnlockTexture(display.get());
+}
+
+void SDLDisplay::present(const frameSnapshot &frame)
+{
+    SDL_MainComponents::updateDisplayTexture(frame);
+    SDL_MainComponents::renderUpdate();
+}
@@ -2,6 +2,7 @@
 #include "SDL_SmartPointer.h"
 #include <SDL3/SDL.h>
 #include "Chip8.h"
+#include "EmulationLoop.h"
 #include <tuple>
 
 class SDL_MainComponents
@@ -10,8 +11,20 @@ class SDL_MainComponents
         static SDL_Window* window;
         static SDL_Renderer* renderer;
         static SDL_SmartTexture display;
+        static uint64_t uploaded[DISPLAY_PLANES][64][2]; // The framebuffer display holds, dirty rows are found against it
+        static uint32_t uploadedPalette[4]; // Palette display was expanded with
+        static bool uploadedAny; // False until display holds a frame, every row is expanded then
+        static Profiler* profiler; // Optional, times draw, upload and present
+        static bool showHud; // Overlay instructions/sec and frame time from profiler
         static void renderUpdate();
         static void init();
+        static void updateDisplayTexture(const frameSnapshot& frame);
         static std::tuple<uint8_t, uint8_t, uint8_t, uint8_t> extractRGBA();
 
-};
\ No newline at end of file
+};
+
+class SDLDisplay
+{
+    public:
+        void present(const frameSnapshot& frame);
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+    public:
+        bool push(const T& item) // Producer only, false when full
+        {
+            size_t write = writeIndex.load(std::memory_order_relaxed);
+            if (write - readIndex.load(std::memory_order_acquire) == Capacity)
+                return false;
+            items[write & (Capacity - 1)] = item;
+            writeIndex.store(write + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool peek(T& item) const // Consumer only, false when empty
+        {
+            size_t read = readIndex.load(std::memory_order_relaxed);
+            if (read == writeIndex.load(std::memory_order_acquire))
+                return false;
+            item = items[read & (Capacity - 1)];
+            return true;
+        }
+
+        void pop() // Consumer only, drops the item peek returned
+        {
+            readIndex.store(readIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+    private:
+        alignas(64) std::atomic<size_t> readIndex{0}; // Separate cache lines so the two sides do not false-share
+        alignas(64) std::atomic<size_t> writeIndex{0};
+        T items[Capacity];
+};
@@ -0,0 +1,245 @@
+#include "Chip8.h"
+#include <array>
+#include <utility>
+
+// Direct-threaded interpreter. Each decode cache entry stores the address of the label that
+// executes it, so every instruction ends in a single indirect jump straight to the next one
+// instead of going through opcodeTable and then a second switch. Common pairs are fused into
+// one entry at decode time:
+//   7xnn + 3xnn / 4xnn  - loop counter increment and test
+//   Annn + Dxyn         - point I at a sprite and draw it
+// Anything rare or complex goes through the entry's regular Opcodes handler.
+// The loop is instantiated once per quirk combination, so quirk checks compile away and the
+// handlers it falls back to are the matching specialisations from Opcodes::decoderFor.
+
+namespace
+{
+    enum threadedOp
+    {
+        OP_CALL, OP_1NNN, OP_3XNN, OP_4XNN, OP_5XY0, OP_6XNN, OP_7XNN,
+        OP_8XY0, OP_8XY1, OP_8XY2, OP_8XY3, OP_8XY4, OP_8XY5, OP_8XY6, OP_8XY7, OP_8XYE,
+        OP_9XY0, OP_ANNN, OP_EX9E, OP_EXA1, OP_FX07, OP_FX15, OP_FX18, OP_FX1E,
+        OP_7XNN_3XNN, OP_7XNN_4XNN, OP_ANNN_DXYN,
+        OP_COUNT
+    };
+
+    threadedOp classify(OpcodeHandler handler)
+    {
+        // Map from the reference handler Opcodes::decode picked so both paths agree on what every opcode means
+        if (handler == &Opcodes::handle1) return OP_1NNN;
+        if (handler == &Opcodes::handle3) return OP_3XNN;
+        if (handler == &Opcodes::handle4) return OP_4XNN;
+        if (handler == &Opcodes::handle5) return OP_5XY0;
+        if (handler == &Opcodes::handle6) return OP_6XNN;
+        if (handler == &Opcodes::handle7) return OP_7XNN;
+        if (handler == &Opcodes::handle8xy0) return OP_8XY0;
+        if (handler == &Opcodes::handle8xy1) return OP_8XY1;
+        if (handler == &Opcodes::handle8xy2) return OP_8XY2;
+        if (handler == &Opcodes::handle8xy3) return OP_8XY3;
+        if (handler == &Opcodes::handle8xy4) return OP_8XY4;
+        if (handler == &Opcodes::handle8xy5) return OP_8XY5;
+        if (handler == &Opcodes::handle8xy6) return OP_8XY6;
+        if (handler == &Opcodes::handle8xy7) return OP_8XY7;
+        if (handler == &Opcodes::handle8xyE) return OP_8XYE;
+        if (handler == &Opcodes::handle9) return OP_9XY0;
+        if (handler == &Opcodes::handleA) return OP_ANNN;
+        if (handler == &Opcodes::handleEx9E) return OP_EX9E;
+        if (handler == &Opcodes::handleExA1) return OP_EXA1;
+        if (handler == &Opcodes::handleFx07) return OP_FX07;
+        if (handler == &Opcodes::handleFx15) return OP_FX15;
+        if (handler == &Opcodes::handleFx18) return OP_FX18;
+        if (handler == &Opcodes::handleFx1E) return OP_FX1E;
+        return OP_CALL;
+    }
+
+    void decodeThreaded(Chip8& chip8, decoded_t& entry, uint16_t pc, const void* const* labels)
+    {
+        if (!entry.handler)
+        {
+            entry.instruction = instruction_t(chip8.memory[pc & chip8.addressMask] << 8 | chip8.memory[(pc + 1) & chip8.addressMask]);
+            entry.handler = chip8.decoder(entry.instruction.opcode);
+        }
+        threadedOp op = classify(Opcodes::decode(entry.instruction.opcode));
+        if (op == OP_7XNN || op == OP_ANNN)
+        {
+            entry.next = instruction_t(chip8.memory[(pc + 2) & chip8.addressMask] << 8 | chip8.memory[(pc + 3) & chip8.addressMask]);
+            OpcodeHandler nextHandler = Opcodes::decode(entry.next.opcode);
+            if (op == OP_7XNN && nextHandler == &Opcodes::handle3) op = OP_7XNN_3XNN;
+            else if (op == OP_7XNN && nextHandler == &Opcodes::handle4) op = OP_7XNN_4XNN;
+            else if (op == OP_ANNN && nextHandler == &Opcodes::handleD) op = OP_ANNN_DXYN;
+        }
+        entry.target = labels[op];
+    }
+}
+
+template <unsigned QuirkBits>
+uint32_t Chip8::runThreaded(uint32_t count)
+{
+    constexpr Quirks q = Quirks::fromBits(QuirkBits);
+    constexpr uint16_t mask = q.xoChip ? 0xFFFF : 0xFFF; // Matches addressMask for these quirks
+#if defined(__GNUC__)
+    static const void* const labels[OP_COUNT] = {
+        &&op_call, &&op_1nnn, &&op_3xnn, &&op_4xnn, &&op_5xy0, &&op_6xnn, &&op_7xnn,
+        &&op_8xy0, &&op_8xy1, &&op_8xy2, &&op_8xy3, &&op_8xy4, &&op_8xy5, &&op_8xy6, &&op_8xy7, &&op_8xye,
+        &&op_9xy0, &&op_annn, &&op_ex9e, &&op_exa1, &&op_fx07, &&op_fx15, &&op_fx18, &&op_fx1e,
+        &&op_7xnn_3xnn, &&op_7xnn_4xnn, &&op_annn_dxyn
+    };
+    uint32_t executed = 0;
+    decoded_t *entry;
+    const instruction_t *in;
+
+    // Fetch the entry at pc, decoding it on first use, and jump to its label
+#define DISPATCH() \
+    do { \
+        if (executed >= count) return executed; \
+        entry = &decodeCache[pc & mask]; \
+        if (!entry->target) decodeThreaded(*this, *entry, pc, labels); \
+        in = &entry->instruction; \
+        goto *entry->target; \
+    } while (0)
+#define NEXT(instructions, advance) \
+    do { executed += (instructions); pc += (advance); DISPATCH(); } while (0)
+// Bytes a taken skip passes over when the instruction to skip is at address
+#define SKIP(address) (q.xoChip && memory[(address) & mask] == 0xF0 && memory[((address) + 1) & mask] == 0x00 ? 4 : 2)
+
+    if (state == STOPPED) return 0;
+    DISPATCH();
+
+op_call:
+    currentInstruction = *in;
+    pc += 2;
+    entry->handler(*this);
+    ++executed;
+    if (state == STOPPED) return executed;
+    DISPATCH();
+op_1nnn:
+    pc = in->nnn;
+    NEXT(1, 0);
+op_3xnn:
+    NEXT(1, V[in->x] == in->nn ? 2 + SKIP(pc + 2) : 2);
+op_4xnn:
+    NEXT(1, V[in->x] != in->nn ? 2 + SKIP(pc + 2) : 2);
+op_5xy0:
+    NEXT(1, V[in->x] == V[in->y] ? 2 + SKIP(pc + 2) : 2);
+op_6xnn:
+    V[in->x] = in->nn;
+    NEXT(1, 2);
+op_7xnn:
+    V[in->x] += in->nn;
+    NEXT(1, 2);
+op_8xy0:
+    V[in->x] = V[in->y];
+    NEXT(1, 2);
+op_8xy1:
+    V[in->x] |= V[in->y];
+    if constexpr (q.vfReset) V[0xF] = 0;
+    NEXT(1, 2);
+op_8xy2:
+    V[in->x] &= V[in->y];
+    if constexpr (q.vfReset) V[0xF] = 0;
+    NEXT(1, 2);
+op_8xy3:
+    V[in->x] ^= V[in->y];
+    if constexpr (q.vfReset) V[0xF] = 0;
+    NEXT(1, 2);
+op_8xy4:
+{
+    int sum = V[in->x] + V[in->y];
+    V[in->x] = sum;
+    V[0xF] = sum > 0xFF;
+    NEXT(1, 2);
+}
+op_8xy5:
+{
+    bool carry = V[in->x] >= V[in->y];
+    V[in->x] -= V[in->y];
+    V[0xF] = carry;
+    NEXT(1, 2);
+}
+op_8xy6:
+{
+    uint8_t value = q.shifting ? V[in->x] : V[in->y];
+    V[in->x] = value >> 1;
+    V[0xF] = value & 0x1;
+    NEXT(1, 2);
+}
+op_8xy7:
+{
+    bool carry = V[in->y] >= V[in->x];
+    V[in->x] = V[in->y] - V[in->x];
+    V[0xF] = carry;
+    NEXT(1, 2);
+}
+op_8xye:
+{
+    uint8_t value = q.shifting ? V[in->x] : V[in->y];
+    V[in->x] = value << 1;
+    V[0xF] = value >> 7;
+    NEXT(1, 2);
+}
+op_9xy0:
+    NEXT(1, V[in->x] != V[in->y] ? 2 + SKIP(pc + 2) : 2);
+op_annn:
+    I = in->nnn;
+    NEXT(1, 2);
+op_ex9e:
+    NEXT(1, keypad[V[in->x] & 0xF] ? 2 + SKIP(pc + 2) : 2);
+op_exa1:
+    NEXT(1, !keypad[V[in->x] & 0xF] ? 2 + SKIP(pc + 2) : 2);
+op_fx07:
+    V[in->x] = delayTimer;
+    NEXT(1, 2);
+op_fx15:
+    delayTimer = V[in->x];
+    NEXT(1, 2);
+op_fx18:
+    soundTimer = V[in->x];
+    NEXT(1, 2);
+op_fx1e:
+    I += V[in->x];
+    NEXT(1, 2);
+op_7xnn_3xnn:
+    if (count - executed < 2) goto op_7xnn; // Not enough budget left for the pair
+    V[in->x] += in->nn;
+    NEXT(2, V[entry->next.x] == entry->next.nn ? 4 + SKIP(pc + 4) : 4);
+op_7xnn_4xnn:
+    if (count - executed < 2) goto op_7xnn;
+    V[in->x] += in->nn;
+    NEXT(2, V[entry->next.x] != entry->next.nn ? 4 + SKIP(pc + 4) : 4);
+op_annn_dxyn:
+    if (count - executed < 2) goto op_annn;
+    I = in->nnn;
+    currentInstruction = entry->next;
+    pc += 4; // Past the Dxyn as op_call does, so a trap in the draw reports the Dxyn
+    if constexpr (q.clipping) updatec8display(); else updatec8displayWrapping();
+    NEXT(2, 0);
+
+#undef SKIP
+#undef NEXT
+#undef DISPATCH
+#else
+    // No computed goto on this compiler, fall back to the decode cache loop
+    uint32_t executed = 0;
+    while (executed < count && state != STOPPED)
+    {
+        emulateInstruction();
+        ++executed;
+    }
+    return executed;
+#endif
+}
+
+namespace
+{
+    template <unsigned... Bits>
+    constexpr std::array<Chip8::threadedRunFn, sizeof...(Bits)> makeRunners(std::integer_sequence<unsigned, Bits...>)
+    {
+        return { &Chip8::runThreaded<Bits>... };
+    }
+}
+
+Chip8::threadedRunFn Chip8::threadedFor(unsigned quirkBits)
+{
+    static constexpr auto runners = makeRunners(std::make_integer_sequence<unsigned, QUIRK_COMBINATIONS>());
+    return runners[quirkBits % QUIRK_COMBINATIONS];
+}
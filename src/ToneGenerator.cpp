@@ -0,0 +1,70 @@
+#include "ToneGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    constexpr int16_t SQUARE_WAVE_HIGH = 32767/100;
+    constexpr int16_t SQUARE_WAVE_LOW = -32768/100;
+    constexpr double PATTERN_RATE = 4000; // XO-CHIP bits per second at the default pitch of 64
+}
+
+ToneGenerator::ToneGenerator()
+{
+    rebuild(soundPattern{ {}, 64, false });
+}
+
+void ToneGenerator::setPattern(const uint8_t *pattern, uint8_t pitch)
+{
+    soundPattern &sound = patterns.back();
+    sound.loaded = pattern != nullptr;
+    if (pattern)
+    {
+        memcpy(sound.bits, pattern, sizeof(sound.bits));
+    }
+    sound.pitch = pitch;
+    patterns.publish();
+}
+
+void ToneGenerator::rebuild(const soundPattern &sound)
+{
+    double bitsPerSecond;
+    if (sound.loaded)
+    {
+        for (int i = 0; i < PATTERN_BITS; ++i)
+        {
+            levels[i] = sound.bits[i / 8] & (0x80 >> i % 8) ? SQUARE_WAVE_HIGH : SQUARE_WAVE_LOW;
+        }
+        bitsPerSecond = PATTERN_RATE * std::pow(2.0, (sound.pitch - 64) / 48.0);
+    }
+    else
+    {
+        // One square wave cycle across the table, so the same loop plays both
+        for (int i = 0; i < PATTERN_BITS; ++i)
+        {
+            levels[i] = i < PATTERN_BITS / 2 ? SQUARE_WAVE_HIGH : SQUARE_WAVE_LOW;
+        }
+        bitsPerSecond = double(FREQUENCY) * PATTERN_BITS;
+    }
+    step = static_cast<uint32_t>(bitsPerSecond / SAMPLE_RATE * (1u << PHASE_SHIFT));
+}
+
+void ToneGenerator::generate(int16_t *out, int count)
+{
+    if (patterns.update())
+    {
+        rebuild(patterns.front());
+    }
+    uint32_t remaining = remainingSamples.load(std::memory_order_relaxed);
+    int tone = static_cast<int>(std::min<uint32_t>(remaining, count));
+    // Nearest-bit resampling, the 32-bit phase wraps exactly at the end of the table
+    for (int i = 0; i < tone; ++i)
+    {
+        out[i] = levels[phase >> PHASE_SHIFT];
+        phase += step;
+    }
+    std::fill(out + tone, out + count, int16_t(0));
+    // A tick that landed meanwhile carries the newer time left, so only count down if nothing changed
+    remainingSamples.compare_exchange_strong(remaining, remaining - tone, std::memory_order_relaxed);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include "TripleBuffer.h"
+
+// Beeper, mono signed 16-bit, one instance per audio device. The emulation thread hands over the
+// sound timer once per tick and the audio thread plays exactly that long: ticks * SAMPLES_PER_TICK
+// samples from the update, so the tone starts and stops on the emulated timer rather than on audio
+// buffer boundaries. The tone is a 128-step table played with a fixed-point phase that carries
+// over between calls: a 440 Hz square wave, or the XO-CHIP pattern once F002 has loaded one.
+// No locks, allocation or SDL.
+class ToneGenerator
+{
+    public:
+        static constexpr int SAMPLE_RATE = 44100;
+        static constexpr int FREQUENCY = 440;
+        static constexpr int SAMPLES_PER_TICK = SAMPLE_RATE / 60;
+        static constexpr int PATTERN_BITS = 128;
+
+        ToneGenerator();
+        void setSoundTimer(uint8_t ticks) // Emulation thread, once per timer tick
+        {
+            remainingSamples.store(ticks * SAMPLES_PER_TICK, std::memory_order_relaxed);
+        }
+        void setPattern(const uint8_t* pattern, uint8_t pitch); // Emulation thread, null pattern for the square wave
+        void generate(int16_t* out, int count); // Audio thread, fills count samples, silence once the timer has run out
+        bool playing() const { return remainingSamples.load(std::memory_order_relaxed) > 0; }
+
+    private:
+        struct soundPattern
+        {
+            uint8_t bits[PATTERN_BITS / 8];
+            uint8_t pitch;
+            bool loaded;
+        };
+        static constexpr int PHASE_SHIFT = 25; // Top 7 bits of the phase index levels, so it wraps with the pattern
+
+        void rebuild(const soundPattern& sound); // Audio thread, levels and step for a new pattern
+
+        TripleBuffer<soundPattern> patterns;
+        std::array<int16_t, PATTERN_BITS> levels; // One output sample per pattern bit
+        uint32_t phase = 0;
+        uint32_t step = 0; // Added to phase per output sample
+        std::atomic<uint32_t> remainingSamples{0};
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Lock-free hand-off of whole values from one writer thread to one reader thread. The writer
+// always has a private buffer to fill and the reader a private buffer to read, the third is
+// swapped between them, so neither side ever waits. The reader only sees the newest value,
+// anything published in between is skipped.
+template <typename T>
+class TripleBuffer
+{
+    public:
+        T& back() { return buffers[backIndex]; } // Writer only
+
+        void publish() // Writer only
+        {
+            backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX;
+        }
+
+        bool update() // Reader only, true when front() changed
+        {
+            if (!(middle.load(std::memory_order_relaxed) & FRESH))
+                return false;
+            frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX;
+            return true;
+        }
+
+        const T& front() const { return buffers[frontIndex]; } // Reader only
+
+    private:
+        static constexpr uint8_t INDEX = 0x3;
+        static constexpr uint8_t FRESH = 0x4; // Set while the middle buffer holds a value the reader has not taken
+        T buffers[3] = {};
+        uint8_t backIndex = 0;
+        std::atomic<uint8_t> middle{1};
+        uint8_t frontIndex = 2;
+};
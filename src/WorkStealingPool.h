@@ -0,0 +1,86 @@
+#pragma once
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs a fixed set of independent tasks across worker threads. Each worker owns a deque, takes
+// from its own back and, once that is empty, steals from the front of the others, so long tasks
+// on one worker do not leave the rest idle. Tasks receive the index of the worker running them
+// so callers can keep per-worker scratch state.
+class WorkStealingPool
+{
+    public:
+        using task = std::function<void(unsigned worker)>;
+
+        static unsigned defaultThreads()
+        {
+            unsigned threads = std::thread::hardware_concurrency();
+            return threads ? threads : 1;
+        }
+
+        // Blocks until every task has run
+        static void run(std::vector<task>& tasks, unsigned threads)
+        {
+            if (threads == 0)
+                threads = defaultThreads();
+            if (threads > tasks.size())
+                threads = tasks.empty() ? 1 : static_cast<unsigned>(tasks.size());
+
+            std::vector<workerQueue> queues(threads);
+            for (size_t i = 0; i < tasks.size(); ++i)
+            {
+                queues[i % threads].tasks.push_back(&tasks[i]); // Round-robin start, stealing balances the rest
+            }
+
+            std::vector<std::thread> workers;
+            for (unsigned worker = 1; worker < threads; ++worker)
+            {
+                workers.emplace_back(workLoop, std::ref(queues), worker);
+            }
+            workLoop(queues, 0); // The calling thread is worker 0
+            for (std::thread& thread : workers)
+            {
+                thread.join();
+            }
+        }
+
+    private:
+        struct workerQueue
+        {
+            std::mutex lock;
+            std::deque<task*> tasks;
+        };
+
+        static void workLoop(std::vector<workerQueue>& queues, unsigned worker)
+        {
+            for (;;)
+            {
+                task* next = nullptr;
+                {
+                    std::lock_guard<std::mutex> guard(queues[worker].lock);
+                    if (!queues[worker].tasks.empty())
+                    {
+                        next = queues[worker].tasks.back();
+                        queues[worker].tasks.pop_back();
+                    }
+                }
+                for (size_t offset = 1; !next && offset < queues.size(); ++offset)
+                {
+                    workerQueue& victim = queues[(worker + offset) % queues.size()];
+                    std::lock_guard<std::mutex> guard(victim.lock);
+                    if (!victim.tasks.empty())
+                    {
+                        next = victim.tasks.front();
+                        victim.tasks.pop_front();
+                    }
+                }
+                if (!next)
+                {
+                    return; // No task is ever added after start, so every queue being empty means done
+                }
+                (*next)(worker);
+            }
+        }
+};
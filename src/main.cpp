@@ -1,16 +1,71 @@
 #include <SDL3/SDL.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include "SDL_MainComponents.h"
 #include "SDL_SmartPointer.h"
+#include "SDLBeep.h"
+#include "SDLInput.h"
+#include "BatchRunner.h"
+#include "Configuration.h"
 #include "Chip8.h"
+#include "EmulationLoop.h"
+#include "FrameScheduler.h"
+#include "Movie.h"
+#include "Profiler.h"
+#include "RewindBuffer.h"
+#include "RomIndex.h"
 #include <filesystem>
 
 SDL_Window* SDL_MainComponents::window = nullptr;
 SDL_Renderer* SDL_MainComponents::renderer = nullptr;
 
+namespace
+{
+    // sdl-c8 --index <rom|dir|@list>... [--database programs.json] [--out file], no window is opened
+    int indexRoms(int argc, char* argv[])
+    {
+        std::vector<std::string> paths;
+        std::string databasePath = "programs.json";
+        std::string outPath = configuration::romIndexPath;
+        for (int i = 2; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "--database" && i + 1 < argc)
+                databasePath = argv[++i];
+            else if (arg == "--out" && i + 1 < argc)
+                outPath = argv[++i];
+            else
+                paths.push_back(arg);
+        }
+        std::vector<std::string> roms = BatchRunner::collectRoms(paths);
+        auto start = std::chrono::steady_clock::now();
+        RomIndex index;
+        romIndexReport report;
+        if (!index.build(roms, databasePath, report))
+        {
+            std::cerr << "Could not read ROM database: " << databasePath << std::endl;
+            return 1;
+        }
+        if (!index.save(outPath))
+        {
+            std::cerr << "Could not write ROM index: " << outPath << std::endl;
+            return 1;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "indexed " << report.matched << " of " << report.roms << " roms (" << report.unreadable << " unreadable) in "
+                  << seconds << " s, written to " << outPath << std::endl;
+        return 0;
+    }
+}
+
 int main(int argc, char* argv[])
 {
-    srand(static_cast<unsigned int>(time(0)));
+    if (argc >= 2 && std::string(argv[1]) == "--index")
+    {
+        return indexRoms(argc, argv);
+    }
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) == false) {
         std::cerr << "SDL_Init Error: " << SDL_GetError() << std::endl;
         return 1;
@@ -23,27 +78,191 @@ int main(int argc, char* argv[])
     else {
         romPath = std::string(argv[1]);
     }
-    Chip8 c8machine(romPath); // Pass ROM path directly if Chip8 expects std::string or const char*
-    SDL_MainComponents::init();
-    SDL_ShowWindow(SDL_MainComponents::window);
-    while (c8machine.state != Chip8::STOPPED)
+    std::string configPath = "default.ini";
+    std::string moviePath; // --record <file> writes the session's input for replay in sdl-c8-bench
+    FrameScheduler scheduler;
+    bool printStats = false;
+    bool threaded = false; // --threaded runs emulation on its own thread, this one only handles SDL
+    bool vsync = false;
+    bool hud = false; // --hud overlays instructions/sec and frame time
+    bool watch = false; // --watch reloads the ROM as soon as it changes on disk
+    bool fixedIpf = false; // --ipf given, the index's rate for the ROM does not replace it
+    int runAhead = 0; // --run-ahead N shows each frame as it will be N frames on, hiding that much input lag
+    std::string profilePath; // --profile-out <base> writes base.json, base.folded and base.ops.folded at exit
+    for (int i = 2; i < argc; ++i)
     {
-        uint64_t startTime = SDL_GetPerformanceCounter();
-        c8machine.handleInput();
-        for (int i = 0; i < 700/60; ++i) 
+        std::string arg = argv[i];
+        if (arg == "--vsync")
+            vsync = true;
+        else if (arg == "--threaded")
+            threaded = true;
+        else if (arg == "--stats")
+            printStats = true;
+        else if (arg == "--hud")
+            hud = true;
+        else if (arg == "--watch")
+            watch = true;
+        else if (i + 1 >= argc)
+            std::cerr << "Missing value for " << arg << std::endl;
+        else if (arg == "--record")
+            moviePath = argv[++i];
+        else if (arg == "--config")
+            configPath = argv[++i];
+        else if (arg == "--profile-out")
+            profilePath = argv[++i];
+        else if (arg == "--ipf")
         {
-        c8machine.emulateInstruction();
+            scheduler.instructionsPerFrame = std::max(1, std::atoi(argv[++i]));
+            fixedIpf = true;
         }
-        uint64_t endTime = SDL_GetPerformanceCounter();
-        uint64_t elapsedTime = endTime - startTime;
-        uint64_t delayTime = (SDL_GetPerformanceFrequency() / 60) - elapsedTime;
-        if (delayTime > 0) {
-            SDL_Delay(delayTime * 1000 / SDL_GetPerformanceFrequency());
+        else if (arg == "--turbo-frames")
+            scheduler.turboFrames = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--run-ahead")
+            runAhead = std::max(0, std::atoi(argv[++i]));
+        else
+            std::cerr << "Unknown option: " << arg << std::endl;
+    }
+    if (!configuration::readConfiguration(configPath.c_str()))
+        std::cerr << "Could not read " << configPath << ", using the built-in chip8 profile" << std::endl;
+    RomIndex romIndex;
+    romIndex.load(configuration::romIndexPath); // Optional, without one every ROM starts on the default profile
+    // Profile from the index entry matching the ROM's contents or else the default, with any [Rom:] overrides on top
+    auto indexedRom = [&romIndex, fixedIpf](const std::string& path, std::vector<uint8_t> bytes)
+    {
+        const romIndexEntry* known = romIndex.find(bytes.data(), bytes.size());
+        romImage rom{ path, std::move(bytes), configuration::quirksForRom(path, known ? RomIndex::profileName(known->profile) : configuration::defaultProfile) };
+        rom.instructionsPerFrame = known && !fixedIpf ? known->instructionsPerFrame : 0;
+        return rom;
+    };
+    romImage startRom = indexedRom(romPath, Chip8::readRom(romPath));
+    Chip8 c8machine(startRom.bytes);
+    c8machine.currentRom = romPath;
+    c8machine.quirks = startRom.quirks;
+    if (startRom.instructionsPerFrame)
+        scheduler.instructionsPerFrame = startRom.instructionsPerFrame;
+    {
+        // Everything holding SDL resources is scoped in here so it is released before SDL_Quit
+        SDL_MainComponents::init();
+        SDL_SetRenderVSync(SDL_MainComponents::renderer, vsync ? 1 : 0);
+        scheduler.vsync = vsync && !threaded; // A separate emulation thread keeps its own time, only the SDL thread waits on VSync
+        SDLBeep beeper;
+        SDLInput input;
+        SDLDisplay video;
+        RewindBuffer rewind; // Several minutes of history at 60 frames per second
+        Movie movie;
+        Profiler profiler;
+    #if !SDL_C8_PROFILER
+        if (!profilePath.empty())
+            std::cerr << "Built without SDL_C8_PROFILER, the profile will have frame timing but no opcode counts" << std::endl;
+    #endif
+        if (hud || !profilePath.empty())
+        {
+            c8machine.profiler = &profiler;
+            SDL_MainComponents::profiler = &profiler;
+            SDL_MainComponents::showHud = hud;
+        }
+        c8machine.seedRandom(static_cast<uint32_t>(time(0)));
+        c8machine.audio = &beeper;
+        movie.start(c8machine, static_cast<uint32_t>(scheduler.instructionsPerFrame));
+        EmulationLoop loop(c8machine, scheduler);
+        loop.rewind = &rewind;
+        loop.movie = moviePath.empty() ? nullptr : &movie;
+        loop.runAhead = runAhead;
+        // Reading happens here on the SDL thread, the loop only swaps the bytes in between frames
+        auto loadRomFile = [&loop, &indexedRom](const std::string& path)
+        {
+            try
+            {
+                return loop.loadRom(indexedRom(path, Chip8::readRom(path)));
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << e.what() << std::endl;
+                return false;
+            }
+        };
+        std::error_code watchError;
+        std::filesystem::file_time_type romWritten = std::filesystem::last_write_time(romPath, watchError);
+        SDL_ShowWindow(SDL_MainComponents::window);
+        if (threaded)
+        {
+            loop.start();
+        }
+        while (!loop.quit && !loop.finished())
+        {
+            {
+                Profiler::Scope scope(SDL_MainComponents::profiler, PHASE_INPUT);
+                input.pollEvents(loop);
+                if (!input.droppedFile.empty())
+                {
+                    if (loadRomFile(input.droppedFile))
+                    {
+                        romPath = input.droppedFile; // Watching follows the dropped ROM
+                        romWritten = std::filesystem::last_write_time(romPath, watchError);
+                    }
+                    input.droppedFile.clear();
+                }
+                if (watch)
+                {
+                    std::filesystem::file_time_type written = std::filesystem::last_write_time(romPath, watchError);
+                    if (!watchError && written != romWritten && loadRomFile(romPath))
+                    {
+                        romWritten = written; // Checked every host frame, so a save shows up on the next one and a failed load is retried
+                    }
+                }
+            }
+            if (!threaded)
+            {
+                Profiler::Scope scope(SDL_MainComponents::profiler, PHASE_EMULATE);
+                loop.step();
+            }
+            if (loop.frames.update())
+            {
+                video.present(loop.frames.front()); // Frames run in a catch-up or turbo burst are never shown
+            }
+            else if (vsync || input.redraw || hud)
+            {
+                SDL_MainComponents::renderUpdate(); // VSync paces the loop through present, exposure and the HUD need a repaint
+            }
+            else if (threaded)
+            {
+                SDL_Delay(1); // Nothing new yet, wait for the emulation thread without spinning
+            }
+            input.redraw = false;
+            trapRecord fault;
+            while (loop.traps.peek(fault))
+            {
+                loop.traps.pop();
+                std::cerr << fault.describe() << std::endl; // Logged here, the emulation only records them
+            }
+            if (SDL_MainComponents::profiler)
+            {
+                profiler.endFrame();
+            }
+            if (!threaded)
+            {
+                scheduler.endFrame();
+            }
+        }
+        loop.stop();
+        if (!profilePath.empty() && !(profiler.writeJson(profilePath + ".json") && profiler.writeCollapsed(profilePath + ".folded")
+                                      && profiler.writeCollapsedOpcodes(profilePath + ".ops.folded")))
+        {
+            std::cerr << "Could not write profile: " << profilePath << std::endl;
+        }
+        if (printStats)
+        {
+            frameStats stats = scheduler.stats();
+            std::cout << "frames: " << stats.emulatedFrames << " emulated, " << stats.loops << " presented, "
+                      << stats.lateFrames << " late, " << stats.droppedFrames << " dropped" << std::endl;
+            std::cout << "frame time ms: mean " << stats.meanMs << ", max " << stats.maxMs << ", jitter " << stats.jitterMs << std::endl;
+        }
+        if (!moviePath.empty() && !movie.save(moviePath))
+        {
+            std::cerr << "Could not write movie: " << moviePath << std::endl;
         }
-        c8machine.updateTimers();
-        SDL_MainComponents::display.reset(c8machine.getDisplayTexture());
-        SDL_MainComponents::renderUpdate();
+        SDL_MainComponents::display.reset(); // A static, left alone it would be destroyed after SDL_Quit too
     }
     SDL_Quit();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,159 @@
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include "Chip8.h"
+#include "Configuration.h"
+
+// Golden-frame regression driver. Runs a ROM headless for a fixed number of frames under a quirk
+// profile, in every interpreter mode, and compares a hash of every frame's framebuffer and the
+// number of frames the tone was on against the checked-in golden file.
+// Usage: golden-frames <roms dir> <golden file> <rom> <profile>
+//        golden-frames <roms dir> <golden file> --update    (rewrite the golden file from the current build)
+
+namespace
+{
+    constexpr uint64_t FRAMES = 600;
+    constexpr int INSTRUCTIONS_PER_FRAME = 100; // Enough for the Timendus tests to finish drawing in FRAMES
+    // keymask.ch8 is not a Timendus test: it loops Ex9E and ExA1 on V0 = 0x13, which must read key 3
+    // lores16.ch8 draws an overlapping pair of low-res Dxy0 sprites, 16x16 on XO-CHIP, and shows VF
+    const char* const ROMS[] = { "opcodes.ch8", "flags.ch8", "quirks.ch8", "keypad.ch8", "scrolling.ch8", "beep.ch8", "keymask.ch8", "lores16.ch8" };
+    const char* const PROFILES[] = { "chip8", "schip-legacy", "schip-modern", "xo-chip" };
+
+    struct goldenResult
+    {
+        uint64_t displayHash = 0; // Each frame's Chip8::displayHash folded in, so transient frames count too
+        uint64_t toneFrames = 0; // Frames that ended with the sound timer running
+
+        bool operator==(const goldenResult& other) const { return displayHash == other.displayHash && toneFrames == other.toneFrames; }
+    };
+
+    // The Timendus ROMs skip their menus when 0x1FF holds a choice, so each profile picks its own platform
+    uint8_t autoSelect(const std::string& rom, const std::string& profile)
+    {
+        if (rom == "quirks.ch8")
+            return profile == "chip8" ? 1 : profile == "schip-modern" ? 2 : profile == "xo-chip" ? 3 : 4;
+        if (rom == "scrolling.ch8")
+            return profile == "xo-chip" ? 4 : profile == "schip-legacy" ? 2 : 1; // Low resolution scrolling for the platform
+        if (rom == "keypad.ch8")
+            return 1; // Ex9E test, highlights keys while they are held
+        return 0;
+    }
+
+    // Keypad script: from frame 60 hold each key for 5 frames, one every 10 frames
+    void scriptKeys(Chip8& chip8, uint64_t frame)
+    {
+        for (int key = 0; key < 16; ++key)
+        {
+            uint64_t down = 60 + key * 10;
+            chip8.keypad[key] = frame >= down && frame < down + 5;
+        }
+    }
+
+    bool run(const std::string& romPath, const std::string& rom, const std::string& profile, Chip8::interpreterMode mode, goldenResult& result)
+    {
+        Quirks quirks;
+        if (!configuration::profileQuirks(profile, quirks))
+        {
+            std::cerr << "Unknown profile: " << profile << std::endl;
+            return false;
+        }
+        Chip8 c8machine(romPath);
+        c8machine.quirks = quirks;
+        c8machine.interpreter = mode;
+        c8machine.skipIdle = mode != Chip8::UNCACHED; // The reference runs every instruction, the others must match it
+        c8machine.seedRandom(1);
+        if (uint8_t choice = autoSelect(rom, profile))
+            c8machine.memory[0x1FF] = choice;
+        result = goldenResult();
+        for (uint64_t frame = 0; frame < FRAMES && c8machine.state != Chip8::STOPPED; ++frame)
+        {
+            if (rom == "keypad.ch8" || rom == "keymask.ch8")
+                scriptKeys(c8machine, frame);
+            c8machine.run(INSTRUCTIONS_PER_FRAME);
+            c8machine.updateTimers();
+            result.toneFrames += c8machine.soundTimer > 0;
+            result.displayHash = (result.displayHash ^ c8machine.displayHash()) * 0x100000001B3ull;
+        }
+        return true;
+    }
+
+    std::map<std::string, goldenResult> readGolden(const std::string& path)
+    {
+        std::map<std::string, goldenResult> golden;
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (line.empty() || line[0] == '#')
+                continue;
+            std::istringstream fields(line);
+            std::string rom, profile;
+            goldenResult result;
+            fields >> rom >> profile >> std::hex >> result.displayHash >> std::dec >> result.toneFrames;
+            if (fields)
+                golden[rom + " " + profile] = result;
+        }
+        return golden;
+    }
+
+    int update(const std::string& romsDir, const std::string& goldenPath)
+    {
+        std::ofstream out(goldenPath);
+        out << "# rom profile display_hash tone_frames, regenerate with: golden-frames roms " << goldenPath << " --update" << std::endl;
+        for (const char* rom : ROMS)
+        {
+            for (const char* profile : PROFILES)
+            {
+                goldenResult result;
+                if (!run(romsDir + "/" + rom, rom, profile, Chip8::UNCACHED, result))
+                    return 1;
+                out << rom << " " << profile << " " << std::hex << std::setw(16) << std::setfill('0') << result.displayHash
+                    << std::dec << std::setfill(' ') << " " << result.toneFrames << std::endl;
+            }
+        }
+        return out ? 0 : 1;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc == 4 && std::string(argv[3]) == "--update")
+    {
+        return update(argv[1], argv[2]);
+    }
+    if (argc != 5)
+    {
+        std::cerr << "Usage: golden-frames <roms dir> <golden file> <rom> <profile>" << std::endl;
+        std::cerr << "       golden-frames <roms dir> <golden file> --update" << std::endl;
+        return 2;
+    }
+    std::string romsDir = argv[1], rom = argv[3], profile = argv[4];
+    auto golden = readGolden(argv[2]);
+    auto expected = golden.find(rom + " " + profile);
+    if (expected == golden.end())
+    {
+        std::cerr << "No golden entry for " << rom << " " << profile << std::endl;
+        return 1;
+    }
+
+    int failures = 0;
+    const char* const names[] = { "uncached", "cached", "threaded", "jit" };
+    for (Chip8::interpreterMode mode : { Chip8::UNCACHED, Chip8::CACHED, Chip8::THREADED, Chip8::JIT })
+    {
+        goldenResult result;
+        if (!run(romsDir + "/" + rom, rom, profile, mode, result))
+            return 1;
+        if (!(result == expected->second))
+        {
+            std::cerr << names[mode] << ": display " << std::hex << result.displayHash << " tone " << std::dec << result.toneFrames
+                      << ", expected display " << std::hex << expected->second.displayHash << " tone " << std::dec << expected->second.toneFrames << std::endl;
+            ++failures;
+        }
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,569 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "BatchRunner.h"
+#include "Chip8.h"
+#include "Configuration.h"
+#include "EmulationLoop.h"
+#include "FrameScheduler.h"
+#include "Movie.h"
+#include "Profiler.h"
+#include "RewindBuffer.h"
+
+// Headless runner: executes a ROM as fast as possible and reports interpreter throughput.
+// Usage: sdl-c8-bench <rom> [--instructions N | --frames N] [--ipf N] [--mode uncached|cached|threaded|jit] [--compare] [--verify] [--rewind] [--run-ahead] [--no-idle]
+//                     [--config file] [--profile P] [--load-state file] [--save-state file] [--record movie | --replay movie]
+//                     [--profile-out base]
+//        sdl-c8-bench --batch <rom|dir|@list>... [--frames N] [--ipf N] [--config file] [--profile P] [--mode M] [--threads N] [--out file]
+
+namespace
+{
+    struct benchResult
+    {
+        uint64_t executed = 0;
+        uint64_t idle = 0; // Part of executed that was skipped idle loop iterations
+        double seconds = 0;
+        trapRecord trap;
+        uint64_t ran() const { return executed - idle; } // What the interpreter actually executed, the rates are based on this
+    };
+
+    bool skipIdle = true; // --no-idle times every instruction, --compare always does
+
+    void printUsage()
+    {
+        std::cerr << "Usage: sdl-c8-bench <rom> [--instructions N | --frames N] [--ipf N] [--mode uncached|cached|threaded|jit] [--compare] [--verify] [--rewind] [--run-ahead] [--no-idle]" << std::endl;
+        std::cerr << "                     [--config file] [--profile P] [--load-state file] [--save-state file] [--record movie | --replay movie]" << std::endl;
+        std::cerr << "                     [--profile-out base]" << std::endl;
+        std::cerr << "       sdl-c8-bench --batch <rom|dir|@list>... [--frames N] [--ipf N] [--config file] [--profile P] [--mode M] [--threads N] [--out file]" << std::endl;
+    }
+
+    const char* modeName(Chip8::interpreterMode mode)
+    {
+        switch (mode)
+        {
+            case Chip8::UNCACHED: return "uncached";
+            case Chip8::CACHED: return "cached";
+            case Chip8::THREADED: return "threaded";
+            case Chip8::JIT: return "jit";
+        }
+        return "unknown";
+    }
+
+    bool parseMode(const std::string& name, Chip8::interpreterMode& mode)
+    {
+        if (name == "uncached") mode = Chip8::UNCACHED;
+        else if (name == "cached") mode = Chip8::CACHED;
+        else if (name == "threaded") mode = Chip8::THREADED;
+        else if (name == "jit") mode = Chip8::JIT;
+        else return false;
+        return true;
+    }
+
+    // Start from a saved state instead of boot when a path is given
+    bool forkFrom(Chip8& c8machine, const std::string& statePath)
+    {
+        if (!statePath.empty() && !c8machine.loadStateFile(statePath))
+        {
+            std::cerr << "Could not load save state: " << statePath << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    benchResult runBench(const std::string& romPath, Chip8::interpreterMode mode, uint64_t instructions, int ipf,
+                         const std::string& loadPath = "", const std::string& savePath = "")
+    {
+        Chip8 c8machine(romPath);
+        c8machine.quirks = configuration::quirksForRom(romPath);
+        c8machine.interpreter = mode;
+        c8machine.skipIdle = skipIdle;
+        benchResult result;
+        if (!forkFrom(c8machine, loadPath))
+        {
+            return result;
+        }
+        auto start = std::chrono::steady_clock::now();
+        while (result.executed < instructions && c8machine.state != Chip8::STOPPED)
+        {
+            // Timers still tick once per emulated frame, just without any pacing
+            uint64_t budget = std::min<uint64_t>(ipf, instructions - result.executed);
+            result.executed += c8machine.run(static_cast<uint32_t>(budget));
+            c8machine.updateTimers();
+        }
+        auto end = std::chrono::steady_clock::now();
+        result.idle = c8machine.idleInstructions;
+        result.seconds = std::chrono::duration<double>(end - start).count();
+        c8machine.takeTrap(result.trap);
+        if (!savePath.empty() && !c8machine.saveStateFile(savePath))
+        {
+            std::cerr << "Could not write save state: " << savePath << std::endl;
+        }
+        return result;
+    }
+
+    // Run with the profiler attached and write base.json, base.folded and base.ops.folded
+    int profileRom(const std::string& romPath, Chip8::interpreterMode mode, uint64_t frames, int ipf, const std::string& base)
+    {
+#if !SDL_C8_PROFILER
+        std::cerr << "Built without SDL_C8_PROFILER, only frame timing will be recorded" << std::endl;
+#endif
+        Chip8 c8machine(romPath);
+        c8machine.quirks = configuration::quirksForRom(romPath);
+        c8machine.interpreter = mode;
+        Profiler profiler;
+        c8machine.profiler = &profiler;
+        for (uint64_t frame = 0; frame < frames && c8machine.state != Chip8::STOPPED; ++frame)
+        {
+            {
+                Profiler::Scope scope(&profiler, PHASE_EMULATE);
+                c8machine.run(static_cast<uint32_t>(ipf));
+                c8machine.updateTimers();
+            }
+            profiler.endFrame();
+        }
+        if (!profiler.writeJson(base + ".json") || !profiler.writeCollapsed(base + ".folded") || !profiler.writeCollapsedOpcodes(base + ".ops.folded"))
+        {
+            std::cerr << "Could not write profile: " << base << std::endl;
+            return 1;
+        }
+        std::cout << "instructions: " << profiler.instructions.load() << std::endl;
+        std::cout << "profile: " << base << ".json" << std::endl;
+        return 0;
+    }
+
+    bool sameState(const Chip8& a, const Chip8& b)
+    {
+        return memcmp(a.V, b.V, sizeof(a.V)) == 0 && a.I == b.I && a.pc == b.pc
+            && a.delayTimer == b.delayTimer && a.soundTimer == b.soundTimer
+            && a.sp == b.sp && memcmp(a.stack, b.stack, sizeof(a.stack)) == 0
+            && memcmp(a.memory, b.memory, sizeof(a.memory)) == 0
+            && memcmp(a.display, b.display, sizeof(a.display)) == 0;
+    }
+
+    // Run the chosen interpreter and the uncached Opcodes path side by side, comparing state after every frame
+    int verify(const std::string& romPath, Chip8::interpreterMode mode, uint64_t frames, int ipf, const std::string& loadPath)
+    {
+        Chip8 candidate(romPath);
+        Chip8 reference(romPath);
+        candidate.quirks = reference.quirks = configuration::quirksForRom(romPath);
+        reference.skipIdle = false; // Skipped idle iterations must leave the same state as running them
+        if (!forkFrom(candidate, loadPath) || !forkFrom(reference, loadPath))
+        {
+            return 1;
+        }
+        candidate.interpreter = mode;
+        reference.interpreter = Chip8::UNCACHED;
+        for (uint64_t frame = 0; frame < frames; ++frame)
+        {
+            candidate.run(ipf);
+            reference.run(ipf);
+            candidate.updateTimers();
+            reference.updateTimers();
+            if (!sameState(candidate, reference))
+            {
+                std::cout << "verify: " << modeName(mode) << " diverged from uncached at frame " << frame
+                          << " (pc " << std::hex << candidate.pc << " vs " << reference.pc << std::dec << ")" << std::endl;
+                return 1;
+            }
+        }
+        std::cout << "verify: " << modeName(mode) << " matched uncached for " << frames << " frames" << std::endl;
+        return 0;
+    }
+
+    // Capture every frame into a rewind buffer, report the capture cost, then rewind and check each frame comes back
+    int rewindCheck(const std::string& romPath, Chip8::interpreterMode mode, uint64_t frames, int ipf)
+    {
+        Chip8 c8machine(romPath);
+        c8machine.quirks = configuration::quirksForRom(romPath);
+        c8machine.interpreter = mode;
+        RewindBuffer rewind;
+        std::vector<uint64_t> hashes;
+        double captureSeconds = 0;
+        for (uint64_t frame = 0; frame < frames && c8machine.state != Chip8::STOPPED; ++frame)
+        {
+            c8machine.run(ipf);
+            c8machine.updateTimers();
+            auto start = std::chrono::steady_clock::now();
+            rewind.push(c8machine);
+            captureSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            hashes.push_back(c8machine.displayHash() ^ (uint64_t(c8machine.pc) << 48) ^ c8machine.rngState);
+        }
+        size_t held = rewind.frames();
+        std::cout << "rewind frames held: " << held << " of " << hashes.size() << std::endl;
+        std::cout << "rewind bytes: " << rewind.bytesUsed() << std::endl;
+        std::cout << "capture us/frame: " << (hashes.empty() ? 0 : captureSeconds * 1e6 / hashes.size()) << std::endl;
+        for (size_t i = 0; i < held; ++i)
+        {
+            uint64_t expected = hashes[hashes.size() - 1 - i];
+            if (!rewind.pop(c8machine) || (c8machine.displayHash() ^ (uint64_t(c8machine.pc) << 48) ^ c8machine.rngState) != expected)
+            {
+                std::cout << "rewind: mismatch " << i << " frames back" << std::endl;
+                return 1;
+            }
+        }
+        std::cout << "rewind: restored all " << held << " frames" << std::endl;
+        return 0;
+    }
+
+    // Step an EmulationLoop a frame at a time with run-ahead off and at 2 to 4 frames, timing each host frame
+    // against the 60 Hz budget and checking the real state ends up where it does without run-ahead
+    int runAheadCheck(const std::string& romPath, Chip8::interpreterMode mode, uint64_t frames, int ipf)
+    {
+        const double budgetUs = 1e6 / 60;
+        uint64_t expected = 0;
+        for (int ahead : { 0, 2, 3, 4 })
+        {
+            Chip8 c8machine(romPath);
+            c8machine.quirks = configuration::quirksForRom(romPath);
+            c8machine.interpreter = mode;
+            c8machine.skipIdle = skipIdle;
+            FrameScheduler scheduler;
+            scheduler.instructionsPerFrame = ipf;
+            scheduler.turboFrames = 1;
+            EmulationLoop loop(c8machine, scheduler);
+            loop.turbo = true; // One frame per step, as fast as it goes
+            loop.runAhead = ahead;
+            double totalUs = 0, worstUs = 0;
+            uint64_t frame = 0;
+            for (; frame < frames && !loop.finished(); ++frame)
+            {
+                auto start = std::chrono::steady_clock::now();
+                loop.step();
+                double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+                totalUs += us;
+                worstUs = std::max(worstUs, us);
+            }
+            std::cout << "run-ahead " << ahead << ": mean us/frame " << (frame ? totalUs / frame : 0) << ", max us/frame " << worstUs
+                      << " (" << 100 * worstUs / budgetUs << "% of budget)" << std::endl;
+            if (ahead == 0)
+            {
+                expected = c8machine.stateHash();
+            }
+            else if (c8machine.stateHash() != expected)
+            {
+                std::cout << "run-ahead: " << ahead << " frames left the real state different after " << frame << " frames" << std::endl;
+                return 1;
+            }
+        }
+        std::cout << "run-ahead: real state unaffected" << std::endl;
+        return 0;
+    }
+
+    // Record a headless run with no input, a baseline later builds can be replayed against
+    int recordMovie(const std::string& romPath, uint64_t frames, int ipf, const std::string& moviePath)
+    {
+        Chip8 c8machine(romPath);
+        c8machine.quirks = configuration::quirksForRom(romPath);
+        Movie movie;
+        movie.start(c8machine, static_cast<uint32_t>(ipf));
+        for (uint64_t frame = 0; frame < frames && c8machine.state != Chip8::STOPPED; ++frame)
+        {
+            c8machine.run(ipf);
+            c8machine.updateTimers();
+            movie.record(c8machine);
+        }
+        if (!movie.save(moviePath))
+        {
+            std::cerr << "Could not write movie: " << moviePath << std::endl;
+            return 1;
+        }
+        std::cout << "recorded frames: " << movie.header.frames << std::endl;
+        return 0;
+    }
+
+    int replayMovie(const std::string& romPath, Chip8::interpreterMode mode, const std::string& moviePath)
+    {
+        Movie movie;
+        if (!movie.load(moviePath))
+        {
+            std::cerr << "Could not read movie: " << moviePath << std::endl;
+            return 1;
+        }
+        Chip8 c8machine(romPath);
+        c8machine.quirks = configuration::quirksForRom(romPath);
+        c8machine.interpreter = mode;
+        replayResult result = movie.replay(c8machine);
+        if (!result.ok)
+        {
+            std::cerr << "Movie was recorded with a different ROM" << std::endl;
+            return 1;
+        }
+        std::cout << "path: " << modeName(mode) << std::endl;
+        std::cout << "replayed frames: " << result.frames << " of " << movie.header.frames << std::endl;
+        std::cout << "elapsed s: " << result.seconds << std::endl;
+        if (result.firstDivergence >= 0)
+        {
+            std::cout << "replay: diverged at frame " << result.firstDivergence << std::endl;
+            return 1;
+        }
+        std::cout << "replay: matched every frame" << std::endl;
+        return 0;
+    }
+
+    // Run many ROMs in parallel and write one CSV line per ROM
+    int batchMain(int argc, char* argv[])
+    {
+        batchOptions options;
+        std::vector<std::string> paths;
+        std::string outPath;
+        for (int i = 2; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg.rfind("--", 0) != 0)
+            {
+                paths.push_back(arg);
+                continue;
+            }
+            if (i + 1 >= argc)
+            {
+                printUsage();
+                return 1;
+            }
+            std::string value = argv[++i];
+            if (arg == "--frames") options.frames = std::strtoull(value.c_str(), nullptr, 10);
+            else if (arg == "--ipf") options.instructionsPerFrame = std::atoi(value.c_str());
+            else if (arg == "--threads") options.threads = static_cast<unsigned>(std::atoi(value.c_str()));
+            else if (arg == "--out") outPath = value;
+            else if (arg == "--mode" && parseMode(value, options.interpreter)) {}
+            else if (arg == "--config" && configuration::readConfiguration(value.c_str())) options.romQuirks = true;
+            else if (arg == "--profile" && configuration::profileQuirks(value, options.quirks)) configuration::defaultProfile = value;
+            else
+            {
+                printUsage();
+                return 1;
+            }
+        }
+        std::vector<std::string> roms = BatchRunner::collectRoms(paths);
+        if (roms.empty() || options.instructionsPerFrame <= 0)
+        {
+            printUsage();
+            return 1;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<batchResult> results = BatchRunner::run(roms, options);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::ofstream outFile;
+        if (!outPath.empty())
+        {
+            outFile.open(outPath);
+        }
+        std::ostream& out = outPath.empty() ? std::cout : outFile;
+        int failures = 0;
+        out << "rom,status,display_hash,instructions,seconds,trap" << std::endl;
+        for (const batchResult& result : results)
+        {
+            out << result.romPath << "," << (result.ok ? "ok" : result.error) << ","
+                << std::hex << std::setw(16) << std::setfill('0') << result.displayHash << std::dec << std::setfill(' ') << ","
+                << result.instructions << "," << result.seconds << "," << (result.trap.count ? result.trap.describe() : "") << std::endl;
+            failures += !result.ok;
+        }
+        std::cerr << roms.size() << " roms in " << seconds << " s" << std::endl;
+        return failures ? 1 : 0;
+    }
+
+    void printResult(const benchResult& result, Chip8::interpreterMode mode, int ipf)
+    {
+        std::cout << "path: " << modeName(mode) << std::endl;
+        std::cout << "instructions: " << result.executed << std::endl;
+        std::cout << "idle skipped: " << result.idle << std::endl;
+        std::cout << "instructions run: " << result.ran() << std::endl;
+        std::cout << "frames: " << (result.executed + ipf - 1) / ipf << std::endl;
+        std::cout << "elapsed s: " << result.seconds << std::endl;
+        std::cout << "instructions/sec: " << (result.seconds > 0 ? result.ran() / result.seconds : 0) << std::endl;
+        if (result.trap.count)
+        {
+            std::cout << "trap: " << result.trap.describe() << std::endl;
+        }
+        std::cout << "ns/instruction: " << (result.ran() > 0 ? result.seconds * 1e9 / result.ran() : 0) << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        printUsage();
+        return 1;
+    }
+    if (std::string(argv[1]) == "--batch")
+    {
+        return batchMain(argc, argv);
+    }
+    std::string romPath = argv[1];
+    uint64_t frames = 0;
+    uint64_t instructions = 50000000; // Default budget when neither limit is given
+    int ipf = configuration::INSTRUCTIONS_PER_FRAME;
+    Chip8::interpreterMode mode = Chip8::CACHED;
+    bool compare = false; // Run every interpreter and report speedups against the uncached Opcodes path
+    bool lockstep = false; // Check --mode against the uncached path instead of timing it
+    bool rewindTest = false;
+    bool runAheadTest = false;
+    std::string loadPath, savePath;
+    std::string recordPath, replayPath;
+    std::string profilePath;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--compare")
+        {
+            compare = true;
+            continue;
+        }
+        if (arg == "--verify")
+        {
+            lockstep = true;
+            continue;
+        }
+        if (arg == "--rewind")
+        {
+            rewindTest = true;
+            continue;
+        }
+        if (arg == "--run-ahead")
+        {
+            runAheadTest = true;
+            continue;
+        }
+        if (arg == "--no-idle")
+        {
+            skipIdle = false;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            printUsage();
+            return 1;
+        }
+        if (arg == "--instructions")
+        {
+            instructions = std::strtoull(argv[++i], nullptr, 10);
+            frames = 0;
+        }
+        else if (arg == "--frames")
+        {
+            frames = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--ipf")
+        {
+            ipf = std::atoi(argv[++i]);
+        }
+        else if (arg == "--load-state")
+        {
+            loadPath = argv[++i];
+        }
+        else if (arg == "--save-state")
+        {
+            savePath = argv[++i];
+        }
+        else if (arg == "--record")
+        {
+            recordPath = argv[++i];
+        }
+        else if (arg == "--replay")
+        {
+            replayPath = argv[++i];
+        }
+        else if (arg == "--profile-out")
+        {
+            profilePath = argv[++i];
+        }
+        else if (arg == "--config")
+        {
+            if (!configuration::readConfiguration(argv[++i]))
+            {
+                std::cerr << "Could not read configuration " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--profile")
+        {
+            Quirks quirks;
+            if (!configuration::profileQuirks(argv[++i], quirks))
+            {
+                printUsage();
+                return 1;
+            }
+            configuration::defaultProfile = argv[i]; // Per-ROM overrides from --config still apply on top
+        }
+        else if (arg == "--mode")
+        {
+            if (!parseMode(argv[++i], mode))
+            {
+                printUsage();
+                return 1;
+            }
+        }
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+    if (ipf <= 0)
+    {
+        std::cerr << "Instructions per frame must be positive" << std::endl;
+        return 1;
+    }
+    if (frames > 0)
+    {
+        instructions = frames * ipf;
+    }
+
+    std::cout << "rom: " << romPath << std::endl;
+    if (!replayPath.empty())
+    {
+        return replayMovie(romPath, mode, replayPath);
+    }
+    if (!recordPath.empty())
+    {
+        return recordMovie(romPath, (instructions + ipf - 1) / ipf, ipf, recordPath);
+    }
+    if (!profilePath.empty())
+    {
+        return profileRom(romPath, mode, (instructions + ipf - 1) / ipf, ipf, profilePath);
+    }
+    if (rewindTest)
+    {
+        return rewindCheck(romPath, mode, (instructions + ipf - 1) / ipf, ipf);
+    }
+    if (runAheadTest)
+    {
+        return runAheadCheck(romPath, mode, (instructions + ipf - 1) / ipf, ipf);
+    }
+    if (lockstep)
+    {
+        return verify(romPath, mode, (instructions + ipf - 1) / ipf, ipf, loadPath);
+    }
+    if (!compare)
+    {
+        printResult(runBench(romPath, mode, instructions, ipf, loadPath, savePath), mode, ipf);
+        return 0;
+    }
+
+    skipIdle = false; // Every instruction goes through the interpreter being compared, probing would time the same code for all of them
+    benchResult baseline;
+    for (Chip8::interpreterMode m : { Chip8::UNCACHED, Chip8::CACHED, Chip8::THREADED, Chip8::JIT })
+    {
+        benchResult result = runBench(romPath, m, instructions, ipf, loadPath);
+        printResult(result, m, ipf);
+        if (m == Chip8::UNCACHED)
+        {
+            baseline = result;
+        }
+        else if (result.seconds > 0 && baseline.ran() > 0)
+        {
+            double speedup = (result.ran() / result.seconds) / (baseline.ran() / baseline.seconds);
+            std::cout << "speedup vs uncached: " << speedup << "x" << std::endl;
+        }
+    }
+    return 0;
+}
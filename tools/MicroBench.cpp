@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Chip8.h"
+#include "Opcodes.h"
+#include "PixelExpand.h"
+#include "ToneGenerator.h"
+
+// Times the hot kernels one at a time: interpreter dispatch on synthetic opcode streams, sprite
+// drawing, framebuffer to RGBA expansion, 00E0, scrolling, and tone and XO-CHIP pattern generation.
+// Each kernel is warmed up, then sampled repeatedly and reported as median and p99 nanoseconds per
+// unit of work.
+// Usage: sdl-c8-microbench [--samples N] [--filter text] [--out file.csv]
+
+namespace
+{
+    using clock = std::chrono::steady_clock;
+    constexpr int WARMUP_SAMPLES = 20;
+    constexpr uint32_t DISPATCH_BATCH = 1000; // Instructions per run call
+
+    struct kernelResult
+    {
+        std::string name;
+        double medianNs = 0;
+        double p99Ns = 0;
+    };
+
+    struct benchSettings
+    {
+        int samples = 200;
+        std::string filter; // Only kernels whose name contains this
+    };
+
+    // Each sample times repeat calls of body, and each call does units of work
+    template <typename Body>
+    kernelResult measure(const std::string& name, const benchSettings& settings, int repeat, uint64_t units, Body body)
+    {
+        for (int sample = 0; sample < WARMUP_SAMPLES; ++sample)
+        {
+            for (int i = 0; i < repeat; ++i)
+                body();
+        }
+        std::vector<double> ns(settings.samples);
+        for (double& sample : ns)
+        {
+            auto start = clock::now();
+            for (int i = 0; i < repeat; ++i)
+                body();
+            sample = std::chrono::duration<double, std::nano>(clock::now() - start).count() / (repeat * units);
+        }
+        std::sort(ns.begin(), ns.end());
+        kernelResult result;
+        result.name = name;
+        result.medianNs = ns[ns.size() / 2];
+        result.p99Ns = ns[std::min(ns.size() - 1, ns.size() * 99 / 100)];
+        return result;
+    }
+
+    std::vector<uint8_t> assemble(const std::vector<uint16_t>& opcodes)
+    {
+        std::vector<uint8_t> rom;
+        for (uint16_t opcode : opcodes)
+        {
+            rom.push_back(opcode >> 8);
+            rom.push_back(opcode & 0xFF);
+        }
+        return rom;
+    }
+
+    // Endless loops at 0x200, each ending in a jump back to the start
+    const std::vector<uint16_t> ALU_STREAM = {
+        0x6005, 0x6107, 0x7001, 0x8014, 0x8105, 0x8012, 0x8311, 0x8403, 0x8016, 0x810E, 0x8237, 0x8540, 0x1200
+    };
+    const std::vector<uint16_t> BRANCH_STREAM = {
+        0x7001, 0x3000, 0x7101, 0x4100, 0x6200, 0x5120, 0x9120, 0x7201, 0x3201, 0x6300, 0x1200
+    };
+    const std::vector<uint16_t> MIXED_STREAM = {
+        0x7001, 0xA300, 0xF01E, 0x2212, 0xF107, 0x8014, 0x3000, 0xF215, 0x1200,
+        0xF007, 0x7101, 0x00EE // Subroutine at 0x212
+    };
+
+    void dispatchKernels(const benchSettings& settings, std::vector<kernelResult>& results)
+    {
+        struct stream { const char* name; const std::vector<uint16_t>* opcodes; };
+        struct mode { const char* name; Chip8::interpreterMode interpreter; };
+        for (const stream& s : { stream{ "alu", &ALU_STREAM }, stream{ "branch", &BRANCH_STREAM }, stream{ "mixed", &MIXED_STREAM } })
+        {
+            for (const mode& m : { mode{ "uncached", Chip8::UNCACHED }, mode{ "cached", Chip8::CACHED },
+                                   mode{ "threaded", Chip8::THREADED }, mode{ "jit", Chip8::JIT } })
+            {
+                std::string name = std::string("dispatch.") + s.name + "." + m.name;
+                if (name.find(settings.filter) == std::string::npos)
+                    continue;
+                Chip8 c8machine(assemble(*s.opcodes));
+                c8machine.interpreter = m.interpreter;
+                results.push_back(measure(name, settings, 1, DISPATCH_BATCH, [&] { c8machine.run(DISPATCH_BATCH); }));
+            }
+        }
+    }
+
+    void drawKernels(const benchSettings& settings, std::vector<kernelResult>& results)
+    {
+        struct sprite { const char* name; bool highRes; uint16_t opcode; };
+        for (const sprite& s : { sprite{ "draw.lores.8row", false, 0xD018 }, sprite{ "draw.hires.8row", true, 0xD018 },
+                                 sprite{ "draw.hires.16x16", true, 0xD010 } })
+        {
+            if (std::string(s.name).find(settings.filter) == std::string::npos)
+                continue;
+            Chip8 c8machine(std::vector<uint8_t>{});
+            c8machine.highResDisplay = s.highRes;
+            c8machine.V[0] = 13; // Unaligned, so rows straddle both display words in high-res
+            c8machine.V[1] = 5;
+            c8machine.I = 0x50;
+            c8machine.currentInstruction = instruction_t(s.opcode);
+            results.push_back(measure(s.name, settings, 1000, 1, [&] { c8machine.updatec8display(); }));
+        }
+    }
+
+    void frameKernels(const benchSettings& settings, std::vector<kernelResult>& results)
+    {
+        Chip8 c8machine(std::vector<uint8_t>{});
+        for (int y = 0; y < 64; ++y)
+        {
+            c8machine.display[0][y][0] = 0x0123456789ABCDEFull * (y + 1);
+            c8machine.display[0][y][1] = ~c8machine.display[0][y][0];
+            c8machine.display[1][y][0] = 0xFEDCBA9876543210ull * (y + 1);
+            c8machine.display[1][y][1] = ~c8machine.display[1][y][0];
+        }
+        static uint32_t pixels[64 * 128];
+        const uint32_t palette[4] = { 0x000000FF, 0xFFFFFFFF, 0xAAAAAAFF, 0x555555FF };
+        if (std::string("texture.expand").find(settings.filter) != std::string::npos)
+        {
+            results.push_back(measure("texture.expand", settings, 100, 1, [&] {
+                for (int y = 0; y < 64; ++y)
+                    PixelExpand::expandRow(c8machine.display[0][y], c8machine.display[1][y], pixels + y * 128, palette);
+            }));
+        }
+        if (std::string("texture.expand.scalar").find(settings.filter) != std::string::npos)
+        {
+            results.push_back(measure("texture.expand.scalar", settings, 100, 1, [&] {
+                for (int y = 0; y < 64; ++y)
+                    PixelExpand::expandRowScalar(c8machine.display[0][y], c8machine.display[1][y], pixels + y * 128, palette);
+            }));
+        }
+        if (std::string("clear.00E0").find(settings.filter) != std::string::npos)
+        {
+            results.push_back(measure("clear.00E0", settings, 1000, 1, [&] { Opcodes::handle00E0(c8machine); }));
+        }
+        c8machine.highResDisplay = true;
+        if (std::string("scroll.down.00C4").find(settings.filter) != std::string::npos)
+        {
+            results.push_back(measure("scroll.down.00C4", settings, 1000, 1, [&] { c8machine.scrollVertical(4); }));
+        }
+        if (std::string("scroll.right.00FB").find(settings.filter) != std::string::npos)
+        {
+            results.push_back(measure("scroll.right.00FB", settings, 1000, 1, [&] { c8machine.scrollHorizontal(4); }));
+        }
+    }
+
+    void audioKernels(const benchSettings& settings, std::vector<kernelResult>& results)
+    {
+        static int16_t samples[4096];
+        if (std::string("audio.tone.4096").find(settings.filter) != std::string::npos)
+        {
+            ToneGenerator tone;
+            results.push_back(measure("audio.tone.4096", settings, 10, 1, [&] {
+                tone.setSoundTimer(255); // Keep the tone on, silence would only time the fill
+                tone.generate(samples, 4096);
+            }));
+        }
+        if (std::string("audio.pattern.4096").find(settings.filter) != std::string::npos)
+        {
+            ToneGenerator tone;
+            const uint8_t pattern[16] = { 0xF0, 0xCC, 0xAA, 0x0F, 0x33, 0x55, 0xFF, 0x00, 0x81, 0x42, 0x24, 0x18, 0xE7, 0xDB, 0xBD, 0x7E };
+            tone.setPattern(pattern, 255); // Highest pitch, the most bits per output sample
+            results.push_back(measure("audio.pattern.4096", settings, 10, 1, [&] {
+                tone.setSoundTimer(255);
+                tone.generate(samples, 4096);
+            }));
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    benchSettings settings;
+    std::string outPath;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Usage: sdl-c8-microbench [--samples N] [--filter text] [--out file.csv]" << std::endl;
+            return 1;
+        }
+        if (arg == "--samples") settings.samples = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--filter") settings.filter = argv[++i];
+        else if (arg == "--out") outPath = argv[++i];
+        else
+        {
+            std::cerr << "Usage: sdl-c8-microbench [--samples N] [--filter text] [--out file.csv]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<kernelResult> results;
+    dispatchKernels(settings, results);
+    drawKernels(settings, results);
+    frameKernels(settings, results);
+    audioKernels(settings, results);
+
+    std::cout << std::left << std::setw(28) << "kernel" << std::right << std::setw(12) << "median ns" << std::setw(12) << "p99 ns" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    for (const kernelResult& result : results)
+    {
+        std::cout << std::left << std::setw(28) << result.name << std::right << std::setw(12) << result.medianNs << std::setw(12) << result.p99Ns << std::endl;
+    }
+    if (!outPath.empty())
+    {
+        std::ofstream out(outPath);
+        out << "kernel,median_ns,p99_ns,samples" << std::endl;
+        for (const kernelResult& result : results)
+        {
+            out << result.name << "," << result.medianNs << "," << result.p99Ns << "," << settings.samples << std::endl;
+        }
+        if (!out)
+        {
+            std::cerr << "Could not write results: " << outPath << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}